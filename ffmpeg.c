@@ -163,6 +163,7 @@ static int restore_tty;
 
 #if HAVE_PTHREADS
 static void free_input_threads(void);
+static void free_encoder_threads(void);
 #endif
 
 /* sub2video hack:
@@ -472,6 +473,10 @@ static void ffmpeg_cleanup(int ret)
         av_log(NULL, AV_LOG_INFO, "bench: maxrss=%ikB\n", maxrss);
     }
 
+#if HAVE_PTHREADS
+    free_encoder_threads();
+#endif
+
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
         avfilter_graph_free(&fg->graph);
@@ -506,6 +511,7 @@ static void ffmpeg_cleanup(int ret)
         }
         av_freep(&fg->outputs);
         av_freep(&fg->graph_desc);
+        av_freep(&fg->shared_desc);
 
         av_freep(&filtergraphs[i]);
     }
@@ -659,6 +665,25 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+/* same as update_benchmark(), with a timer of the output stream, as the
+ * encoders may run in their own threads */
+static void update_encoder_benchmark(OutputStream *ost, const char *fmt, ...)
+{
+    if (do_benchmark_all) {
+        int64_t t = getutime();
+        va_list va;
+        char buf[1024];
+
+        if (fmt) {
+            va_start(va, fmt);
+            vsnprintf(buf, sizeof(buf), fmt, va);
+            va_end(va);
+            av_log(NULL, AV_LOG_INFO, "bench: %8"PRIu64" %s \n", t - ost->bench_time, buf);
+        }
+        ost->bench_time = t;
+    }
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
@@ -668,7 +693,49 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
-static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
+#if HAVE_PTHREADS
+/* protects the muxers and the muxing state of the output streams
+ * when encoders run in their own threads */
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t output_lock_owner;
+static int output_lock_held;
+#endif
+
+static void lock_output(void)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&output_lock);
+    output_lock_owner = pthread_self();
+    output_lock_held  = 1;
+#endif
+}
+
+static void unlock_output(void)
+{
+#if HAVE_PTHREADS
+    output_lock_held = 0;
+    pthread_mutex_unlock(&output_lock);
+#endif
+}
+
+/* write_packet() may mark streams as finished from an encoder thread */
+static OSTFinished output_stream_finished(OutputStream *ost)
+{
+    OSTFinished finished;
+
+    lock_output();
+    finished = ost->finished;
+    unlock_output();
+
+    return finished;
+}
+
+/*
+ * Write a packet to the muxer, or queue it until the header is written.
+ *
+ * @return  0 for success, <0 for errors the caller has to abort on
+ */
+static int write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
     AVStream *st = ost->st;
@@ -685,7 +752,7 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
     if (!(st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && ost->encoding_needed) && !unqueue) {
         if (ost->frame_number >= ost->max_frames) {
             av_packet_unref(pkt);
-            return;
+            return 0;
         }
         ost->frame_number++;
     }
@@ -700,18 +767,21 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                 av_log(NULL, AV_LOG_ERROR,
                        "Too many packets buffered for output stream %d:%d.\n",
                        ost->file_index, ost->st->index);
-                exit_program(1);
+                av_packet_unref(pkt);
+                return AVERROR(ENOSPC);
             }
             ret = av_fifo_realloc2(ost->muxing_queue, new_size);
-            if (ret < 0)
-                exit_program(1);
+            if (ret < 0) {
+                av_packet_unref(pkt);
+                return ret;
+            }
         }
         ret = av_packet_ref(&tmp_pkt, pkt);
+        av_packet_unref(pkt);
         if (ret < 0)
-            exit_program(1);
+            return ret;
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
-        av_packet_unref(pkt);
-        return;
+        return 0;
     }
 
     if ((st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && video_sync_method == VSYNC_DROP) ||
@@ -766,7 +836,8 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
                        ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
                 if (exit_on_error) {
                     av_log(NULL, AV_LOG_FATAL, "aborting.\n");
-                    exit_program(1);
+                    av_packet_unref(pkt);
+                    return AVERROR(EINVAL);
                 }
                 av_log(s, loglevel, "changing to %"PRId64". This may result "
                        "in incorrect timestamps in the output file.\n",
@@ -801,13 +872,16 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
         close_all_output_streams(ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
     }
     av_packet_unref(pkt);
+    return 0;
 }
 
 static void close_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
 
+    lock_output();
     ost->finished |= ENCODER_FINISHED;
+    unlock_output();
     if (of->shortest) {
         int64_t end = av_rescale_q(ost->sync_opts - ost->first_pts, ost->enc_ctx->time_base, AV_TIME_BASE_Q);
         of->recording_time = FFMIN(of->recording_time, end);
@@ -824,9 +898,13 @@ static void close_output_stream(OutputStream *ost)
  * If eof is set, instead indicate EOF to all bitstream filters and
  * therefore flush any delayed packets to the output.  A blank packet
  * must be supplied in this case.
+ *
+ * Must be called with the output lock held while encoder threads are running.
+ *
+ * @return  0 for success, <0 for errors the caller has to abort on
  */
-static void output_packet(OutputFile *of, AVPacket *pkt,
-                          OutputStream *ost, int eof)
+static int output_packet(OutputFile *of, AVPacket *pkt,
+                         OutputStream *ost, int eof)
 {
     int ret = 0;
 
@@ -861,19 +939,20 @@ static void output_packet(OutputFile *of, AVPacket *pkt,
                 eof = 0;
             } else if (eof)
                 goto finish;
-            else
-                write_packet(of, pkt, ost, 0);
+            else if ((ret = write_packet(of, pkt, ost, 0)) < 0)
+                return ret;
         }
     } else if (!eof)
-        write_packet(of, pkt, ost, 0);
+        return write_packet(of, pkt, ost, 0);
 
 finish:
     if (ret < 0 && ret != AVERROR_EOF) {
         av_log(NULL, AV_LOG_ERROR, "Error applying bitstream filters to an output "
                "packet for stream #%d:%d.\n", ost->file_index, ost->index);
         if(exit_on_error)
-            exit_program(1);
+            return ret;
     }
+    return 0;
 }
 
 static int check_recording_time(OutputStream *ost)
@@ -889,8 +968,8 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
-static void do_audio_out(OutputFile *of, OutputStream *ost,
-                         AVFrame *frame)
+static int encode_audio_frame(OutputFile *of, OutputStream *ost,
+                              AVFrame *frame)
 {
     AVCodecContext *enc = ost->enc_ctx;
     AVPacket pkt;
@@ -900,17 +979,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
     pkt.data = NULL;
     pkt.size = 0;
 
-    if (!check_recording_time(ost))
-        return;
-
-    if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
-        frame->pts = ost->sync_opts;
-    ost->sync_opts = frame->pts + frame->nb_samples;
-    ost->samples_encoded += frame->nb_samples;
-    ost->frames_encoded++;
-
-    av_assert0(pkt.size || !pkt.data);
-    update_benchmark(NULL);
+    update_encoder_benchmark(ost, NULL);
     if (debug_ts) {
         av_log(NULL, AV_LOG_INFO, "encoder <- type:audio "
                "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
@@ -920,17 +989,18 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
 
     ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
-        goto error;
+        return ret;
 
     while (1) {
         ret = avcodec_receive_packet(enc, &pkt);
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
-            goto error;
+            return ret;
 
-        update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
+        update_encoder_benchmark(ost, "encode_audio %d.%d", ost->file_index, ost->index);
 
+        lock_output();
         av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
 
         if (debug_ts) {
@@ -940,13 +1010,216 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
         }
 
-        output_packet(of, &pkt, ost, 0);
+        ret = output_packet(of, &pkt, ost, 0);
+        unlock_output();
+        if (ret < 0)
+            return ret;
     }
 
-    return;
-error:
-    av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
-    exit_program(1);
+    return 0;
+}
+
+static int encode_video_frame(OutputFile *of, OutputStream *ost,
+                              AVFrame *in_picture)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket pkt;
+    int ret, frame_size = 0;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    update_encoder_benchmark(ost, NULL);
+    if (debug_ts) {
+        av_log(NULL, AV_LOG_INFO, "encoder <- type:video "
+               "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
+               av_ts2str(in_picture->pts), av_ts2timestr(in_picture->pts, &enc->time_base),
+               enc->time_base.num, enc->time_base.den);
+    }
+
+    ret = avcodec_send_frame(enc, in_picture);
+    if (ret < 0)
+        return ret;
+
+    while (1) {
+        ret = avcodec_receive_packet(enc, &pkt);
+        update_encoder_benchmark(ost, "encode_video %d.%d", ost->file_index, ost->index);
+        if (ret == AVERROR(EAGAIN))
+            break;
+        if (ret < 0)
+            return ret;
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                   av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                   av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+        }
+
+        if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+            pkt.pts = in_picture->pts;
+
+        lock_output();
+        av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
+                av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
+        }
+
+        frame_size = pkt.size;
+        ret = output_packet(of, &pkt, ost, 0);
+
+        /* if two pass, output log */
+        if (ost->logfile && enc->stats_out) {
+            fprintf(ost->logfile, "%s", enc->stats_out);
+        }
+        unlock_output();
+        if (ret < 0)
+            return ret;
+    }
+
+    if (vstats_filename && frame_size) {
+        lock_output();
+        do_video_stats(ost, frame_size);
+        unlock_output();
+    }
+
+    return 0;
+}
+
+#if HAVE_PTHREADS
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    OutputFile    *of = output_files[ost->file_index];
+    AVFrame    *frame;
+    int ret = 0;
+
+    while (av_thread_message_queue_recv(ost->enc_queue, &frame, 0) >= 0) {
+        if (ret >= 0) {
+            if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+                ret = encode_video_frame(of, ost, frame);
+            else
+                ret = encode_audio_frame(of, ost, frame);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Encoding failed for output stream %d:%d: %s\n",
+                       ost->file_index, ost->index, av_err2str(ret));
+                /* make the next send from the main thread fail */
+                av_thread_message_queue_set_err_send(ost->enc_queue, ret);
+            }
+        }
+        av_frame_free(&frame);
+    }
+    ost->enc_thread_ret = ret;
+
+    return NULL;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    /* open it here, so that do_video_stats() cannot fail in the thread */
+    if (vstats_filename && !vstats_file) {
+        vstats_file = fopen(vstats_filename, "w");
+        if (!vstats_file)
+            return AVERROR(errno);
+    }
+
+    ret = av_thread_message_queue_alloc(&ost->enc_queue, ost->enc_thread_queue_size,
+                                        sizeof(AVFrame *));
+    if (ret < 0)
+        return ret;
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&ost->enc_queue);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+/*
+ * Wait until the encoder thread of ost has encoded all queued frames
+ * and terminate it.
+ *
+ * @return  0 for success, <0 if encoding failed in the thread
+ */
+static int free_encoder_thread(OutputStream *ost)
+{
+    if (!ost || !ost->enc_queue)
+        return 0;
+
+    av_thread_message_queue_set_err_recv(ost->enc_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+    av_thread_message_queue_free(&ost->enc_queue);
+
+    return ost->enc_thread_ret;
+}
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    /* exit_program() called while muxing; encoder threads never call it,
+     * they return their errors to the main thread */
+    if (output_lock_held && pthread_equal(output_lock_owner, pthread_self()))
+        unlock_output();
+
+    for (i = 0; i < nb_output_streams; i++)
+        free_encoder_thread(output_streams[i]);
+}
+#endif
+
+/*
+ * Encode a frame, either directly or by handing a new reference to it over
+ * to the encoder thread of the stream.
+ */
+static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+#if HAVE_PTHREADS
+    if (ost->enc_thread_queue_size > 0) {
+        AVFrame *queued;
+        int ret;
+
+        if (!ost->enc_queue && (ret = init_encoder_thread(ost)) < 0)
+            return ret;
+
+        queued = av_frame_clone(frame);
+        if (!queued)
+            return AVERROR(ENOMEM);
+        ret = av_thread_message_queue_send(ost->enc_queue, &queued, 0);
+        if (ret < 0)
+            av_frame_free(&queued);
+        return ret;
+    }
+#endif
+    if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO)
+        return encode_video_frame(of, ost, frame);
+    return encode_audio_frame(of, ost, frame);
+}
+
+static void do_audio_out(OutputFile *of, OutputStream *ost,
+                         AVFrame *frame)
+{
+    if (!check_recording_time(ost))
+        return;
+
+    if (frame->pts == AV_NOPTS_VALUE || audio_sync_method < 0)
+        frame->pts = ost->sync_opts;
+    ost->sync_opts = frame->pts + frame->nb_samples;
+    ost->samples_encoded += frame->nb_samples;
+    ost->frames_encoded++;
+
+    if (encode_frame(of, ost, frame) < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
+        exit_program(1);
+    }
 }
 
 static void do_subtitle_out(OutputFile *of,
@@ -954,7 +1227,7 @@ static void do_subtitle_out(OutputFile *of,
                             AVSubtitle *sub)
 {
     int subtitle_out_max_size = 1024 * 1024;
-    int subtitle_out_size, nb, i;
+    int subtitle_out_size, nb, i, ret;
     AVCodecContext *enc;
     AVPacket pkt;
     int64_t pts;
@@ -1028,7 +1301,11 @@ static void do_subtitle_out(OutputFile *of,
                 pkt.pts += av_rescale_q(sub->end_display_time, (AVRational){ 1, 1000 }, ost->mux_timebase);
         }
         pkt.dts = pkt.pts;
-        output_packet(of, &pkt, ost, 0);
+        lock_output();
+        ret = output_packet(of, &pkt, ost, 0);
+        unlock_output();
+        if (ret < 0)
+            exit_program(1);
     }
 }
 
@@ -1045,7 +1322,6 @@ static void do_video_out(OutputFile *of,
     int nb_frames, nb0_frames, i;
     double delta, delta0;
     double duration = 0;
-    int frame_size = 0;
     InputStream *ist = NULL;
     AVFilterContext *filter = ost->filter->filter;
 
@@ -1214,7 +1490,11 @@ static void do_video_out(OutputFile *of,
         pkt.pts    = av_rescale_q(in_picture->pts, enc->time_base, ost->mux_timebase);
         pkt.flags |= AV_PKT_FLAG_KEY;
 
-        output_packet(of, &pkt, ost, 0);
+        lock_output();
+        ret = output_packet(of, &pkt, ost, 0);
+        unlock_output();
+        if (ret < 0)
+            goto error;
     } else
 #endif
     {
@@ -1275,55 +1555,11 @@ static void do_video_out(OutputFile *of,
             av_log(NULL, AV_LOG_DEBUG, "Forced keyframe at time %f\n", pts_time);
         }
 
-        update_benchmark(NULL);
-        if (debug_ts) {
-            av_log(NULL, AV_LOG_INFO, "encoder <- type:video "
-                   "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
-                   av_ts2str(in_picture->pts), av_ts2timestr(in_picture->pts, &enc->time_base),
-                   enc->time_base.num, enc->time_base.den);
-        }
-
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
+        ret = encode_frame(of, ost, in_picture);
         if (ret < 0)
             goto error;
-
-        while (1) {
-            ret = avcodec_receive_packet(enc, &pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
-            if (ret < 0)
-                goto error;
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
-
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
-
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
-            }
-
-            frame_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
-
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
-            }
-        }
     }
     ost->sync_opts++;
     /*
@@ -1332,9 +1568,6 @@ static void do_video_out(OutputFile *of,
      * flush, we need to limit them here, before they go into encoder.
      */
     ost->frame_number++;
-
-    if (vstats_filename && frame_size)
-        do_video_stats(ost, frame_size);
   }
 
     if (!ost->last_frame)
@@ -1406,12 +1639,14 @@ static void finish_output_stream(OutputStream *ost)
     OutputFile *of = output_files[ost->file_index];
     int i;
 
+    lock_output();
     ost->finished = ENCODER_FINISHED | MUXER_FINISHED;
 
     if (of->shortest) {
         for (i = 0; i < of->ctx->nb_streams; i++)
             output_streams[of->ost_index + i]->finished = ENCODER_FINISHED | MUXER_FINISHED;
     }
+    unlock_output();
 }
 
 /**
@@ -1466,7 +1701,7 @@ static int reap_filters(int flush)
                 }
                 break;
             }
-            if (ost->finished) {
+            if (output_stream_finished(ost)) {
                 av_frame_unref(filtered_frame);
                 continue;
             }
@@ -1676,6 +1911,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     t = (cur_time-timer_start) / 1000000.0;
 
+    /* the muxing state and statistics are updated by the encoder threads */
+    lock_output();
 
     oc = output_files[0]->ctx;
 
@@ -1758,6 +1995,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         if (is_last_report)
             nb_frames_drop += ost->last_dropped;
     }
+    unlock_output();
 
     secs = FFABS(pts) / AV_TIME_BASE;
     us = FFABS(pts) % AV_TIME_BASE;
@@ -1839,6 +2077,15 @@ static void flush_encoders(void)
 {
     int i, ret;
 
+#if HAVE_PTHREADS
+    for (i = 0; i < nb_output_streams; i++) {
+        if (free_encoder_thread(output_streams[i]) < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Encoding failed\n");
+            exit_program(1);
+        }
+    }
+#endif
+
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream   *ost = output_streams[i];
         AVCodecContext *enc = ost->enc_ctx;
@@ -1925,7 +2172,7 @@ static void flush_encoders(void)
                 pkt.data = NULL;
                 pkt.size = 0;
 
-                update_benchmark(NULL);
+                update_encoder_benchmark(ost, NULL);
 
                 while ((ret = avcodec_receive_packet(enc, &pkt)) == AVERROR(EAGAIN)) {
                     ret = avcodec_send_frame(enc, NULL);
@@ -1937,7 +2184,7 @@ static void flush_encoders(void)
                     }
                 }
 
-                update_benchmark("flush_%s %d.%d", desc, ost->file_index, ost->index);
+                update_encoder_benchmark(ost, "flush_%s %d.%d", desc, ost->file_index, ost->index);
                 if (ret < 0 && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
                            desc,
@@ -1948,7 +2195,8 @@ static void flush_encoders(void)
                     fprintf(ost->logfile, "%s", enc->stats_out);
                 }
                 if (ret == AVERROR_EOF) {
-                    output_packet(of, &pkt, ost, 1);
+                    if (output_packet(of, &pkt, ost, 1) < 0)
+                        exit_program(1);
                     break;
                 }
                 if (ost->finished & MUXER_FINISHED) {
@@ -1957,7 +2205,8 @@ static void flush_encoders(void)
                 }
                 av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
                 pkt_size = pkt.size;
-                output_packet(of, &pkt, ost, 0);
+                if (output_packet(of, &pkt, ost, 0) < 0)
+                    exit_program(1);
                 if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && vstats_filename) {
                     do_video_stats(ost, pkt_size);
                 }
@@ -1976,7 +2225,7 @@ static int check_output_constraints(InputStream *ist, OutputStream *ost)
     if (ost->source_index != ist_index)
         return 0;
 
-    if (ost->finished)
+    if (output_stream_finished(ost))
         return 0;
 
     if (of->start_time != AV_NOPTS_VALUE && ist->pts < of->start_time)
@@ -1993,6 +2242,7 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     int64_t ost_tb_start_time = av_rescale_q(start_time, AV_TIME_BASE_Q, ost->mux_timebase);
     AVPicture pict;
     AVPacket opkt;
+    int ret;
 
     av_init_packet(&opkt);
 
@@ -2084,7 +2334,7 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
         ost->st->codecpar->codec_id == AV_CODEC_ID_RAWVIDEO &&
         (of->ctx->oformat->flags & AVFMT_RAWPICTURE)) {
         /* store AVPicture in AVPacket, as expected by the output format */
-        int ret = avpicture_fill(&pict, opkt.data, ost->st->codecpar->format, ost->st->codecpar->width, ost->st->codecpar->height);
+        ret = avpicture_fill(&pict, opkt.data, ost->st->codecpar->format, ost->st->codecpar->width, ost->st->codecpar->height);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "avpicture_fill failed: %s\n",
                    av_err2str(ret));
@@ -2096,7 +2346,11 @@ static void do_streamcopy(InputStream *ist, OutputStream *ost, const AVPacket *p
     }
 #endif
 
-    output_packet(of, &opkt, ost, 0);
+    lock_output();
+    ret = output_packet(of, &opkt, ost, 0);
+    unlock_output();
+    if (ret < 0)
+        exit_program(1);
 }
 
 int guess_input_channel_layout(InputStream *ist)
@@ -2956,8 +3210,10 @@ static int check_init_output_file(OutputFile *of, int file_index)
 
     of->ctx->interrupt_callback = int_cb;
 
+    lock_output();
     ret = avformat_write_header(of->ctx, &of->opts);
     if (ret < 0) {
+        unlock_output();
         av_log(NULL, AV_LOG_ERROR,
                "Could not write header for output file #%d "
                "(incorrect codec parameters ?): %s\n",
@@ -2983,9 +3239,14 @@ static int check_init_output_file(OutputFile *of, int file_index)
         while (av_fifo_size(ost->muxing_queue)) {
             AVPacket pkt;
             av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
-            write_packet(of, &pkt, ost, 1);
+            ret = write_packet(of, &pkt, ost, 1);
+            if (ret < 0) {
+                unlock_output();
+                return ret;
+            }
         }
     }
+    unlock_output();
 
     return 0;
 }
@@ -3798,11 +4059,17 @@ static int need_output(void)
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int finished, max_frames_reached;
+
+        lock_output();
+        finished = ost->finished ||
+                   (os->pb && avio_tell(os->pb) >= of->limit_filesize);
+        max_frames_reached = ost->frame_number >= ost->max_frames;
+        unlock_output();
 
-        if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+        if (finished)
             continue;
-        if (ost->frame_number >= ost->max_frames) {
+        if (max_frames_reached) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
                 close_output_stream(output_streams[of->ost_index + j]);
@@ -3837,7 +4104,7 @@ static OutputStream *choose_output(void)
         if (!ost->initialized && !ost->inputs_done)
             return ost;
 
-        if (!ost->finished && opts < opts_min) {
+        if (!output_stream_finished(ost) && opts < opts_min) {
             opts_min = opts;
             ost_min  = ost->unavailable ? NULL : ost;
         }
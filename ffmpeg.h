@@ -223,6 +223,8 @@ typedef struct OptionsContext {
     int        nb_passlogfiles;
     SpecifierOpt *max_muxing_queue_size;
     int        nb_max_muxing_queue_size;
+    SpecifierOpt *enc_thread_queue_size;
+    int        nb_enc_thread_queue_size;
     SpecifierOpt *guess_layout_max;
     int        nb_guess_layout_max;
     SpecifierOpt *apad;
@@ -289,6 +291,8 @@ typedef struct OutputFilter {
 typedef struct FilterGraph {
     int            index;
     const char    *graph_desc;
+    /* description of a simple filtergraph shared by several output streams */
+    char          *shared_desc;
 
     AVFilterGraph *graph;
     int reconfiguration;
@@ -558,6 +562,18 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+    /* time of the last -benchmark_all measurement of the encoder */
+    int64_t bench_time;
+
+    /* maximum number of frames queued for the encoder thread,
+     * 0 to encode from the main thread */
+    int enc_thread_queue_size;
+#if HAVE_PTHREADS
+    AVThreadMessageQueue *enc_queue;
+    pthread_t enc_thread;        /* thread encoding frames for this stream */
+    int enc_thread_ret;          /* error code of the encoder thread */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -617,6 +633,7 @@ extern float max_error_rate;
 extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
+extern int share_filters;
 extern int filter_complex_nbthreads;
 extern int vstats_version;
 
@@ -651,6 +668,7 @@ void choose_sample_fmt(AVStream *st, AVCodec *codec);
 int configure_filtergraph(FilterGraph *fg);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 void check_filter_outputs(void);
+void share_simple_filtergraphs(void);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
 int filtergraph_is_simple(FilterGraph *fg);
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost);
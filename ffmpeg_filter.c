@@ -693,6 +693,218 @@ void check_filter_outputs(void)
     }
 }
 
+#define MAX_SHARED_CHAIN_FILTERS 64
+#define MAX_SHARED_CHAIN_OUTPUTS 32
+
+/**
+ * Find the ends of the filters of a plain filter chain, i.e. the offsets of
+ * its top-level commas and of its terminating nul.
+ *
+ * @return the number of filters in the chain, 0 if the description is not
+ *         a plain chain (labels, several chains, ...)
+ */
+static int split_filter_chain(const char *desc, int *ends)
+{
+    const char *p;
+    int nb_filters = 0, quoted = 0;
+
+    for (p = desc; *p; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '\'') {
+            quoted = !quoted;
+        } else if (!quoted) {
+            if (*p == '[' || *p == ';')
+                return 0;
+            if (*p == ',') {
+                if (nb_filters == MAX_SHARED_CHAIN_FILTERS - 1)
+                    return 0;
+                ends[nb_filters++] = p - desc;
+            }
+        }
+    }
+    if (quoted)
+        return 0;
+    ends[nb_filters++] = p - desc;
+
+    return nb_filters;
+}
+
+static int same_dict(AVDictionary *a, AVDictionary *b)
+{
+    char *sa = NULL, *sb = NULL;
+    int ret;
+
+    if (av_dict_get_string(a, &sa, '=', ':') < 0 ||
+        av_dict_get_string(b, &sb, '=', ':') < 0)
+        exit_program(1);
+    ret = !strcmp(sa, sb);
+    av_free(sa);
+    av_free(sb);
+
+    return ret;
+}
+
+/* whether two simple filtergraphs would be configured with the same options */
+static int same_simple_graph_options(OutputStream *a, OutputStream *b)
+{
+    AVDictionaryEntry *ta = av_dict_get(a->encoder_opts, "threads", NULL, 0);
+    AVDictionaryEntry *tb = av_dict_get(b->encoder_opts, "threads", NULL, 0);
+
+    if (!ta != !tb || (ta && strcmp(ta->value, tb->value)))
+        return 0;
+
+    return same_dict(a->sws_dict,      b->sws_dict) &&
+           same_dict(a->swr_opts,      b->swr_opts) &&
+           same_dict(a->resample_opts, b->resample_opts);
+}
+
+/* compare two lists of formats terminated by -1 (AV_PIX_FMT_NONE) */
+static int same_format_list(const int *a, const int *b)
+{
+    if (!a || !b)
+        return a == b;
+    for (; *a == *b; a++, b++)
+        if (*a == AV_PIX_FMT_NONE)
+            return 1;
+    return 0;
+}
+
+static int same_string(char *a, char *b)
+{
+    int ret = a && b ? !strcmp(a, b) : a == b;
+
+    av_free(a);
+    av_free(b);
+
+    return ret;
+}
+
+/*
+ * Whether the outputs of two simple filtergraphs are constrained to the same
+ * formats. The split at the end of a shared chain negotiates a single format,
+ * so outputs needing different ones would get a second conversion.
+ */
+static int same_output_formats(OutputFilter *a, OutputFilter *b)
+{
+    if (a->type == AVMEDIA_TYPE_VIDEO)
+        return a->ost->keep_pix_fmt == b->ost->keep_pix_fmt &&
+               a->format == b->format &&
+               (a->format != AV_PIX_FMT_NONE ? a->ost->enc == b->ost->enc :
+                same_format_list(a->formats, b->formats));
+
+    return same_string(choose_sample_fmts(a),      choose_sample_fmts(b))  &&
+           same_string(choose_sample_rates(a),     choose_sample_rates(b)) &&
+           same_string(choose_channel_layouts(a),  choose_channel_layouts(b));
+}
+
+static void remove_filtergraph(FilterGraph *fg)
+{
+    InputFilter *ifilter = fg->inputs[0];
+    InputStream *ist     = ifilter->ist;
+    int i;
+
+    for (i = 0; i < ist->nb_filters; i++) {
+        if (ist->filters[i] == ifilter) {
+            memmove(ist->filters + i, ist->filters + i + 1,
+                    (ist->nb_filters - i - 1) * sizeof(*ist->filters));
+            ist->nb_filters--;
+            break;
+        }
+    }
+
+    for (i = fg->index + 1; i < nb_filtergraphs; i++) {
+        filtergraphs[i - 1] = filtergraphs[i];
+        filtergraphs[i - 1]->index = i - 1;
+    }
+    nb_filtergraphs--;
+
+    av_fifo_freep(&ifilter->frame_queue);
+    av_freep(&fg->inputs[0]);
+    av_freep(&fg->inputs);
+    av_freep(&fg->outputs);
+    av_free(fg);
+}
+
+void share_simple_filtergraphs(void)
+{
+    int i, j;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        FilterGraph  *fg = filtergraphs[i];
+        OutputStream *ost, *group[MAX_SHARED_CHAIN_OUTPUTS];
+        int ends[MAX_SHARED_CHAIN_FILTERS], nb_group = 1, nb_shared;
+        const char *split;
+        AVBPrint bp;
+
+        if (!filtergraph_is_simple(fg) || fg->nb_outputs != 1)
+            continue;
+        ost = fg->outputs[0]->ost;
+        nb_shared = split_filter_chain(ost->avfilter, ends);
+        if (!nb_shared || !strcmp(ost->avfilter, "null") ||
+            !strcmp(ost->avfilter, "anull"))
+            continue;
+        group[0] = ost;
+
+        /* gather the simple graphs of the same input stream starting with
+         * the same filter, and find the longest chain they all start with */
+        for (j = i + 1; j < nb_filtergraphs && nb_group < FF_ARRAY_ELEMS(group); j++) {
+            FilterGraph  *fg2  = filtergraphs[j];
+            OutputStream *ost2;
+            int ends2[MAX_SHARED_CHAIN_FILTERS], nb_filters2, k;
+
+            if (!filtergraph_is_simple(fg2) || fg2->nb_outputs != 1 ||
+                fg2->inputs[0]->ist != fg->inputs[0]->ist)
+                continue;
+            ost2 = fg2->outputs[0]->ost;
+            if (ost2->st->codecpar->codec_type != ost->st->codecpar->codec_type ||
+                !same_simple_graph_options(ost, ost2) ||
+                !same_output_formats(ost->filter, ost2->filter))
+                continue;
+            nb_filters2 = split_filter_chain(ost2->avfilter, ends2);
+            for (k = 0; k < FFMIN(nb_shared, nb_filters2); k++)
+                if (ends[k] != ends2[k] || strncmp(ost->avfilter, ost2->avfilter, ends[k]))
+                    break;
+            if (!k)
+                continue;
+            nb_shared = k;
+            group[nb_group++] = ost2;
+        }
+        if (nb_group == 1)
+            continue;
+
+        /* run the shared filters once and split their output:
+         * "shared,split=n[s0][s1]...;[s0]tail0;[s1]tail1..." */
+        split = ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ? "" : "a";
+        av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+        av_bprintf(&bp, "%.*s,%ssplit=%d", ends[nb_shared - 1], ost->avfilter,
+                   split, nb_group);
+        for (j = 0; j < nb_group; j++)
+            av_bprintf(&bp, "[s%d]", j);
+        for (j = 0; j < nb_group; j++) {
+            const char *tail = group[j]->avfilter + ends[nb_shared - 1];
+            av_bprintf(&bp, ";[s%d]%s", j, *tail ? tail + 1 : *split ? "anull" : "null");
+        }
+        if (!av_bprint_is_complete(&bp))
+            exit_program(1);
+        av_bprint_finalize(&bp, &fg->shared_desc);
+
+        for (j = 1; j < nb_group; j++) {
+            FilterGraph *fg2 = group[j]->filter->graph;
+
+            GROW_ARRAY(fg->outputs, fg->nb_outputs);
+            fg->outputs[fg->nb_outputs - 1] = group[j]->filter;
+            group[j]->filter->graph = fg;
+            remove_filtergraph(fg2);
+        }
+
+        av_log(NULL, AV_LOG_VERBOSE, "Sharing %d filter(s) of stream #%d:%d "
+               "between %d outputs: %s\n", nb_shared,
+               fg->inputs[0]->ist->file_index, fg->inputs[0]->ist->st->index,
+               nb_group, fg->shared_desc);
+    }
+}
+
 static int sub2video_prepare(InputStream *ist, InputFilter *ifilter)
 {
     AVFormatContext *avf = input_files[ist->file_index]->ctx;
@@ -996,8 +1208,9 @@ int configure_filtergraph(FilterGraph *fg)
 {
     AVFilterInOut *inputs, *outputs, *cur;
     int ret, i, simple = filtergraph_is_simple(fg);
-    const char *graph_desc = simple ? fg->outputs[0]->ost->avfilter :
-                                      fg->graph_desc;
+    const char *graph_desc = fg->shared_desc ? fg->shared_desc :
+                             simple          ? fg->outputs[0]->ost->avfilter :
+                                               fg->graph_desc;
 
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
@@ -1058,7 +1271,16 @@ int configure_filtergraph(FilterGraph *fg)
         }
     }
 
-    if (simple && (!inputs || inputs->next || !outputs || outputs->next)) {
+    if (fg->shared_desc) {
+        for (cur = outputs, i = 0; cur; cur = cur->next)
+            i++;
+        if (!inputs || inputs->next || i != fg->nb_outputs) {
+            av_log(NULL, AV_LOG_ERROR, "Shared filtergraph '%s' has an unexpected "
+                   "number of inputs or outputs.\n", graph_desc);
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+    } else if (simple && (!inputs || inputs->next || !outputs || outputs->next)) {
         const char *num_inputs;
         const char *num_outputs;
         if (!outputs) {
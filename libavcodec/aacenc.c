@@ -506,6 +506,34 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Search the quantizers of one channel using a per-thread copy of the
+ * encoder context, so that the scratch buffers and the quantization cost
+ * cache are not shared between threads.
+ */
+static int search_for_quantizers_job(AVCodecContext *avctx, void *arg,
+                                     int jobnr, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    AACEncContext *t = &s->thread_ctx[threadnr];
+    SingleChannelElement *sce;
+    int i, chans, ch = jobnr;
+
+    for (i = 0; ch >= (chans = s->chan_map[i+1] == TYPE_CPE ? 2 : 1); i++)
+        ch -= chans;
+    sce = &s->cpe[i].ch[ch];
+
+    t->lambda           = s->lambda;
+    t->psy              = s->psy;
+    t->psy.bitres.alloc = s->ch_bitres_alloc[jobnr];
+    t->cur_type         = s->chan_map[i+1];
+    t->cur_channel      = jobnr;
+    if (t->options.pns && t->coder->mark_pns)
+        t->coder->mark_pns(t, avctx, sce);
+    t->coder->search_for_quantizers(avctx, t, sce, t->lambda);
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -519,6 +547,9 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    /* The coder may update the psy cutoff during the first frame, which the
+     * psy analysis of the following channel elements then depends on. */
+    const int threaded = s->thread_ctx && avctx->frame_number > 1;
 
     /* add current frame to queue */
     if (frame) {
@@ -651,8 +682,6 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             cpe->common_window = 0;
             memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
             memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             for (ch = 0; ch < chans; ch++) {
                 sce = &cpe->ch[ch];
                 coeffs[ch] = sce->coeffs;
@@ -677,10 +706,28 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
             s->cur_type = tag;
             for (ch = 0; ch < chans; ch++) {
                 s->cur_channel = start_ch + ch;
+                if (threaded) {
+                    s->ch_bitres_alloc[s->cur_channel] = s->psy.bitres.alloc;
+                    continue;
+                }
                 if (s->options.pns && s->coder->mark_pns)
                     s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
                 s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
             }
+            start_ch += chans;
+        }
+        if (threaded)
+            avctx->execute2(avctx, search_for_quantizers_job, NULL, NULL,
+                            s->channels);
+
+        start_ch = 0;
+        for (i = 0; i < s->chan_map[0]; i++) {
+            FFPsyWindowInfo* wi = windows + start_ch;
+            tag      = s->chan_map[i+1];
+            chans    = tag == TYPE_CPE ? 2 : 1;
+            cpe      = &s->cpe[i];
+            put_bits(&s->pb, 3, tag);
+            put_bits(&s->pb, 4, chan_el_counter[tag]++);
             if (chans > 1
                 && wi[0].window_type[0] == wi[1].window_type[0]
                 && wi[0].window_shape   == wi[1].window_shape) {
@@ -864,6 +911,8 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     av_freep(&s->buffer.samples);
     av_freep(&s->cpe);
     av_freep(&s->fdsp);
+    av_freep(&s->thread_ctx);
+    av_freep(&s->ch_bitres_alloc);
     ff_af_queue_close(&s->afq);
     return 0;
 }
@@ -1044,6 +1093,18 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     ff_af_queue_init(avctx, &s->afq);
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE &&
+        avctx->thread_count > 1 && s->channels > 1) {
+        s->thread_ctx      = av_malloc_array(avctx->thread_count, sizeof(*s->thread_ctx));
+        s->ch_bitres_alloc = av_malloc_array(s->channels, sizeof(*s->ch_bitres_alloc));
+        if (!s->thread_ctx || !s->ch_bitres_alloc) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < avctx->thread_count; i++)
+            memcpy(&s->thread_ctx[i], s, sizeof(*s));
+    }
+
     return 0;
 fail:
     aac_encode_end(avctx);
@@ -1089,7 +1150,8 @@ AVCodec ff_aac_encoder = {
     .defaults       = aac_encode_defaults,
     .supported_samplerates = mpeg4audio_sample_rates,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_FLTP,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &aacenc_class,
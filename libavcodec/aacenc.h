@@ -134,6 +134,9 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext *thread_ctx;            ///< per-thread copies used for the quantizer search
+    int *ch_bitres_alloc;                        ///< psy bit allocation of each channel in the current frame
 } AACEncContext;
 
 void ff_aac_dsp_init_x86(AACEncContext *s);
@@ -203,12 +203,10 @@ int ff_bsf_get_packet(AVBSFContext *ctx, AVPacket **pkt)
     AVBSFInternal *in = ctx->internal;
     AVPacket *tmp_pkt;
 
-    if (in->eof)
-        return AVERROR_EOF;
-
+    /* a packet sent before the EOF has to be returned first */
     if (!ctx->internal->buffer_pkt->data &&
         !ctx->internal->buffer_pkt->side_data_elems)
-        return AVERROR(EAGAIN);
+        return in->eof ? AVERROR_EOF : AVERROR(EAGAIN);
 
     tmp_pkt = av_packet_alloc();
     if (!tmp_pkt)
@@ -224,12 +222,10 @@ int ff_bsf_get_packet_ref(AVBSFContext *ctx, AVPacket *pkt)
 {
     AVBSFInternal *in = ctx->internal;
 
-    if (in->eof)
-        return AVERROR_EOF;
-
+    /* a packet sent before the EOF has to be returned first */
     if (!ctx->internal->buffer_pkt->data &&
         !ctx->internal->buffer_pkt->side_data_elems)
-        return AVERROR(EAGAIN);
+        return in->eof ? AVERROR_EOF : AVERROR(EAGAIN);
 
     av_packet_move_ref(pkt, ctx->internal->buffer_pkt);
 
@@ -371,12 +371,17 @@ static int decode_simple_internal(AVCodecContext *avctx, AVFrame *frame)
     // copy to ensure we do not change pkt
     AVPacket tmp;
     int got_frame, actual_got_frame, did_split;
+    /* the old decoding API expects the frame threads to return one frame per
+     * packet, otherwise packets are submitted without waiting for frames */
+    int async_threads = HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME &&
+                        !avci->compat_decode;
     int ret;
 
     if (!pkt->data && !avci->draining) {
         av_packet_unref(pkt);
         ret = ff_decode_get_packet(avctx, pkt);
-        if (ret < 0 && ret != AVERROR_EOF)
+        if (ret < 0 && ret != AVERROR_EOF &&
+            !(ret == AVERROR(EAGAIN) && async_threads))
             return ret;
     }
 
@@ -411,7 +416,19 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     got_frame = 0;
 
-    if (HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME) {
+    if (async_threads && !avci->draining) {
+        /* do not wait for the decoding threads in avcodec_send_packet(),
+         * the packet stays queued until a thread is available */
+        ret = ff_thread_receive_frame(avctx, frame, &got_frame, &tmp,
+                                      frame != avci->buffer_frame);
+        if (ret == AVERROR(EAGAIN)) {
+#if FF_API_MERGE_SD
+            if (did_split)
+                av_packet_free_side_data(&tmp);
+#endif
+            return ret;
+        }
+    } else if (HAVE_THREADS && avctx->active_thread_type & FF_THREAD_FRAME) {
         ret = ff_thread_decode_frame(avctx, frame, &got_frame, &tmp);
     } else {
         ret = avctx->codec->decode(avctx, frame, &got_frame, &tmp);
@@ -105,6 +105,9 @@ typedef struct DNXHDEncContext {
 
     void (*get_pixels_8x4_sym)(int16_t *av_restrict /* align 16 */ block,
                                const uint8_t *pixels, ptrdiff_t line_size);
+    /** quantize an already transformed block, NULL if dct_quantize must be used */
+    int (*quantize)(MpegEncContext *s, int16_t *block,
+                    int n, int qscale, int *overflow);
 } DNXHDEncContext;
 
 void ff_dnxhdenc_init_x86(DNXHDEncContext *ctx);
@@ -133,7 +133,9 @@ int attribute_align_arg avcodec_encode_audio2(AVCodecContext *avctx,
         return AVERROR(ENOSYS);
     }
 
-    if (!(avctx->codec->capabilities & AV_CODEC_CAP_DELAY) && !frame) {
+    if (!(avctx->codec->capabilities & AV_CODEC_CAP_DELAY) && !frame &&
+        !(CONFIG_FRAME_THREAD_ENCODER &&
+          avctx->internal->frame_thread_encoder && (avctx->active_thread_type&FF_THREAD_FRAME))) {
         av_packet_unref(avpkt);
         av_init_packet(avpkt);
         return 0;
@@ -193,6 +195,12 @@ int attribute_align_arg avcodec_encode_audio2(AVCodecContext *avctx,
         }
     }
 
+    if (CONFIG_FRAME_THREAD_ENCODER &&
+        avctx->internal->frame_thread_encoder && (avctx->active_thread_type&FF_THREAD_FRAME)) {
+        ret = ff_thread_encode_frame(avctx, avpkt, frame, got_packet_ptr);
+        goto end;
+    }
+
     av_assert0(avctx->codec->encode2);
 
     ret = avctx->codec->encode2(avctx, avpkt, frame, got_packet_ptr);
@@ -279,7 +287,7 @@ int attribute_align_arg avcodec_encode_video2(AVCodecContext *avctx,
 
     if(CONFIG_FRAME_THREAD_ENCODER &&
        avctx->internal->frame_thread_encoder && (avctx->active_thread_type&FF_THREAD_FRAME))
-        return ff_thread_video_encode_frame(avctx, avpkt, frame, got_packet_ptr);
+        return ff_thread_encode_frame(avctx, avpkt, frame, got_packet_ptr);
 
     if ((avctx->flags&AV_CODEC_FLAG_PASS1) && avctx->stats_out)
         avctx->stats_out[0] = '\0';
@@ -100,6 +100,17 @@ typedef struct FlacFrame {
     int verbatim_only;
 } FlacFrame;
 
+/**
+ * A frame waiting to be encoded, or to be output, by the frame batches of
+ * the threaded encoder.
+ */
+typedef struct FlacThreadFrame {
+    AVFrame *frame;
+    uint32_t frame_count;
+    AVPacket pkt;
+    int ret;
+} FlacThreadFrame;
+
 typedef struct FlacEncodeContext {
     AVClass *class;
     PutBitContext pb;
@@ -126,6 +137,16 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    /* Threading: frames are independent once the block size is known, so
+     * batches of frames are encoded in parallel and output in order. */
+    struct FlacEncodeContext **thread;
+    int nb_threads;
+    FlacThreadFrame *pending;
+    FlacThreadFrame *done;
+    int nb_pending;
+    int nb_done;
+    int next_done;
 } FlacEncodeContext;
 
 
@@ -236,6 +257,35 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+static av_cold int init_thread_contexts(FlacEncodeContext *s)
+{
+    AVCodecContext *avctx = s->avctx;
+    int i, ret;
+
+    s->nb_threads = avctx->thread_count;
+    s->thread  = av_mallocz_array(s->nb_threads, sizeof(*s->thread));
+    s->pending = av_mallocz_array(s->nb_threads, sizeof(*s->pending));
+    s->done    = av_mallocz_array(s->nb_threads, sizeof(*s->done));
+    if (!s->thread || !s->pending || !s->done)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->nb_threads; i++) {
+        FlacEncodeContext *t = av_malloc(sizeof(*t));
+        if (!t)
+            return AVERROR(ENOMEM);
+        memcpy(t, s, sizeof(*t));
+        s->thread[i] = t;
+
+        ret = ff_lpc_init(&t->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -456,14 +506,22 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
                       s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    if (ret < 0)
+        return ret;
 
     ff_bswapdsp_init(&s->bdsp);
     ff_flacdsp_init(&s->flac_dsp, avctx->sample_fmt, channels,
                     avctx->bits_per_raw_sample);
 
+    if (avctx->active_thread_type == FF_THREAD_SLICE && avctx->thread_count > 1) {
+        ret = init_thread_contexts(s);
+        if (ret < 0)
+            return ret;
+    }
+
     dprint_compression_options(s);
 
-    return ret;
+    return 0;
 }
 
 
@@ -1320,10 +1378,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1344,7 +1403,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1356,6 +1415,147 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples of frame into s->frame.
+ * @return the size of the encoded frame in bytes, or a negative error code
+ */
+static int encode_frame_samples(FlacEncodeContext *s, const AVFrame *frame)
+{
+    int frame_bytes;
+
+    /* change max_framesize for small final frame */
+    if (frame->nb_samples < s->max_blocksize) {
+        s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
+                                                      s->channels,
+                                                      s->avctx->bits_per_raw_sample);
+    }
+
+    init_frame(s, frame->nb_samples);
+
+    copy_samples(s, frame->data[0]);
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0)
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+    }
+
+    return frame_bytes;
+}
+
+
+/**
+ * Update the stream information with an encoded frame and set the
+ * properties of its packet. Must be called in coding order.
+ */
+static int output_frame(FlacEncodeContext *s, AVPacket *avpkt,
+                        const AVFrame *frame, int out_bytes)
+{
+    int ret;
+
+    s->sample_count += frame->nb_samples;
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+        av_log(s->avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+        return ret;
+    }
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+
+    avpkt->pts      = frame->pts;
+    avpkt->duration = ff_samples_to_time_base(s->avctx, frame->nb_samples);
+    avpkt->size     = out_bytes;
+
+    s->next_pts = avpkt->pts + avpkt->duration;
+
+    return 0;
+}
+
+
+static int encode_frame_thread(AVCodecContext *avctx, void *arg,
+                               int jobnr, int threadnr)
+{
+    FlacEncodeContext *s  = avctx->priv_data;
+    FlacEncodeContext *t  = s->thread[threadnr];
+    FlacThreadFrame   *tf = &s->pending[jobnr];
+    int frame_bytes;
+
+    t->frame_count   = tf->frame_count;
+    t->max_framesize = s->max_framesize;
+
+    frame_bytes = encode_frame_samples(t, tf->frame);
+    if (frame_bytes < 0) {
+        tf->ret = frame_bytes;
+        return 0;
+    }
+
+    tf->ret = ff_alloc_packet2(avctx, &tf->pkt, frame_bytes, frame_bytes);
+    if (tf->ret >= 0)
+        tf->ret = write_frame(t, &tf->pkt);
+    return 0;
+}
+
+
+/**
+ * Gather frames into batches of nb_threads frames, encode each batch in
+ * parallel and return its packets one by one while the next batch is
+ * gathered.
+ */
+static int encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                 const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacThreadFrame *tf;
+    int ret;
+
+    if (frame) {
+        tf = &s->pending[s->nb_pending];
+        tf->frame = av_frame_clone(frame);
+        if (!tf->frame)
+            return AVERROR(ENOMEM);
+        tf->frame_count = s->frame_count++;
+        s->nb_pending++;
+    }
+
+    if (!s->nb_done && s->nb_pending &&
+        (!frame || s->nb_pending == s->nb_threads)) {
+        avctx->execute2(avctx, encode_frame_thread, NULL, NULL, s->nb_pending);
+        FFSWAP(FlacThreadFrame *, s->pending, s->done);
+        s->nb_done    = s->nb_pending;
+        s->next_done  = 0;
+        s->nb_pending = 0;
+    }
+
+    if (!s->nb_done)
+        return 0;
+
+    tf = &s->done[s->next_done++];
+    s->nb_done--;
+
+    ret = tf->ret;
+    if (ret >= 0) {
+        av_packet_move_ref(avpkt, &tf->pkt);
+        ret = output_frame(s, avpkt, tf->frame, tf->ret);
+        if (ret >= 0)
+            *got_packet_ptr = 1;
+    }
+    av_packet_unref(&tf->pkt);
+    av_frame_free(&tf->frame);
+
+    return ret;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1364,6 +1564,12 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->thread) {
+        ret = encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+        if (ret < 0 || *got_packet_ptr || frame)
+            return ret;
+    }
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1392,33 +1598,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
         return 0;
     }
 
-    /* change max_framesize for small final frame */
-    if (frame->nb_samples < s->frame.blocksize) {
-        s->max_framesize = ff_flac_get_max_frame_size(frame->nb_samples,
-                                                      s->channels,
-                                                      avctx->bits_per_raw_sample);
-    }
-
-    init_frame(s, frame->nb_samples);
-
-    copy_samples(s, frame->data[0]);
-
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = encode_frame_samples(s, frame);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_alloc_packet2(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
@@ -1426,31 +1608,42 @@ FF_ENABLE_DEPRECATION_WARNINGS
     out_bytes = write_frame(s, avpkt);
 
     s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+    if ((ret = output_frame(s, avpkt, frame, out_bytes)) < 0)
         return ret;
-    }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
-
-    avpkt->pts      = frame->pts;
-    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
-    avpkt->size     = out_bytes;
-
-    s->next_pts = avpkt->pts + avpkt->duration;
 
     *got_packet_ptr = 1;
     return 0;
 }
 
 
+static void free_thread_frames(FlacThreadFrame *frames, int nb_frames)
+{
+    int i;
+
+    for (i = 0; frames && i < nb_frames; i++) {
+        av_frame_free(&frames[i].frame);
+        av_packet_unref(&frames[i].pkt);
+    }
+}
+
+
 static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
+        int i;
+
+        for (i = 0; s->thread && i < s->nb_threads; i++) {
+            if (s->thread[i])
+                ff_lpc_end(&s->thread[i]->lpc_ctx);
+            av_freep(&s->thread[i]);
+        }
+        av_freep(&s->thread);
+        free_thread_frames(s->pending, s->nb_threads);
+        free_thread_frames(s->done,    s->nb_threads);
+        av_freep(&s->pending);
+        av_freep(&s->done);
+
         av_freep(&s->md5ctx);
         av_freep(&s->md5_buffer);
         ff_lpc_end(&s->lpc_ctx);
@@ -1508,9 +1701,11 @@ AVCodec ff_flac_encoder = {
     .init           = flac_encode_init,
     .encode2        = flac_encode_frame,
     .close          = flac_encode_close,
-    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS,
+    .capabilities   = AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_DELAY | AV_CODEC_CAP_LOSSLESS |
+                      AV_CODEC_CAP_SLICE_THREADS,
     .sample_fmts    = (const enum AVSampleFormat[]){ AV_SAMPLE_FMT_S16,
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
     .priv_class     = &flac_encoder_class,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
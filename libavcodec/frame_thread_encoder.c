@@ -37,6 +37,8 @@ typedef struct{
     void *outdata;
     int64_t return_code;
     unsigned index;
+    int64_t first_frame;    ///< GOP mode: number of frames before this GOP
+    int64_t first_dts;      ///< GOP mode: dts of the first packet of this GOP
 } Task;
 
 typedef struct{
@@ -56,8 +58,278 @@ typedef struct{
 
     pthread_t worker[MAX_THREADS];
     int exit;
+
+    /* GOP mode: each task is a closed GOP encoded by a fresh encoder */
+    AVCodecContext *gop_template;   ///< unopened copy of the parent context
+    AVDictionary *options;
+    int gop_size;                   ///< length of the GOPs cut by the encoder
+    int gop_lookahead;              ///< frames needed after a GOP to know it is complete
+    AVFifoBuffer *gop_frames;       ///< frames of the GOP being gathered
+    int64_t gop_first_frame;
+    int64_t gop_last_pts;           ///< pts of the last frame submitted
+    AVFifoBuffer *gop_packets;      ///< packets of the GOP being returned
 } ThreadContext;
 
+static AVCodecContext *clone_context(const AVCodecContext *avctx)
+{
+    AVCodecContext *thread_avctx = avcodec_alloc_context3(avctx->codec);
+    void *tmpv;
+
+    if (!thread_avctx)
+        return NULL;
+    tmpv = thread_avctx->priv_data;
+    *thread_avctx = *avctx;
+    thread_avctx->priv_data = tmpv;
+    thread_avctx->internal = NULL;
+    if (avctx->codec->priv_class) {
+        if (av_opt_copy(thread_avctx->priv_data, avctx->priv_data) < 0) {
+            av_opt_free(thread_avctx->priv_data);
+            av_freep(&thread_avctx->priv_data);
+            av_freep(&thread_avctx);
+            return NULL;
+        }
+    } else
+        memcpy(thread_avctx->priv_data, avctx->priv_data, avctx->codec->priv_data_size);
+    thread_avctx->thread_count = 1;
+    thread_avctx->active_thread_type &= ~FF_THREAD_FRAME;
+
+    return thread_avctx;
+}
+
+static void free_unopened_context(AVCodecContext **avctx)
+{
+    if (!*avctx)
+        return;
+    if ((*avctx)->codec->priv_class)
+        av_opt_free((*avctx)->priv_data);
+    av_freep(&(*avctx)->priv_data);
+    av_freep(avctx);
+}
+
+static void free_gop_frames(ThreadContext *c, AVFifoBuffer **frames)
+{
+    AVFrame *frame;
+
+    if (!*frames)
+        return;
+    while (av_fifo_size(*frames) > 0) {
+        av_fifo_generic_read(*frames, &frame, sizeof(frame), NULL);
+        pthread_mutex_lock(&c->buffer_mutex);
+        av_frame_unref(frame);
+        pthread_mutex_unlock(&c->buffer_mutex);
+        av_frame_free(&frame);
+    }
+    av_fifo_freep(frames);
+}
+
+static void free_gop_packets(AVFifoBuffer **packets)
+{
+    AVPacket pkt;
+
+    if (!*packets)
+        return;
+    while (av_fifo_size(*packets) > 0) {
+        av_fifo_generic_read(*packets, &pkt, sizeof(pkt), NULL);
+        av_packet_unref(&pkt);
+    }
+    av_fifo_freep(packets);
+}
+
+/**
+ * Check whether the encoder can be run on whole closed GOPs independently.
+ * This is only done if slice threading was not requested, as it raises the
+ * latency to a few GOPs.
+ */
+static int gops_are_independent(AVCodecContext *avctx)
+{
+    if (   avctx->codec_id != AV_CODEC_ID_MPEG1VIDEO
+        && avctx->codec_id != AV_CODEC_ID_MPEG2VIDEO
+        && avctx->codec_id != AV_CODEC_ID_MPEG4)
+        return 0;
+
+    if (   (avctx->thread_type & FF_THREAD_SLICE)
+        || !(avctx->flags & AV_CODEC_FLAG_CLOSED_GOP)
+        || avctx->gop_size <= 1
+        || avctx->gop_size + avctx->max_b_frames > 600)
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Check that the closed GOPs encoded in parallel give the same output as
+ * a single encoder. The GOPs are cut where it would cut them, so this is
+ * the case as long as no decision depends on the frames of previous GOPs.
+ */
+static int check_gop_settings(AVCodecContext *avctx)
+{
+    int64_t b_strategy = 0, skip_threshold = 0, skip_factor = 0;
+    int64_t noise_reduction = 0, mpv_flags = 0;
+    const AVOption *strict_gop;
+
+    if (   !(avctx->flags & AV_CODEC_FLAG_QSCALE)
+        || (avctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2))) {
+        av_log(avctx, AV_LOG_ERROR,
+               "Frame multi-threading of closed GOPs has no common bit budget "
+               "for the GOPs encoded in parallel, it needs a constant quantizer "
+               "and single pass encoding. Use -qscale or -thread_type slice.\n");
+        return AVERROR(EINVAL);
+    }
+
+    av_opt_get_int(avctx->priv_data, "b_strategy",      0, &b_strategy);
+    av_opt_get_int(avctx->priv_data, "skip_threshold",  0, &skip_threshold);
+    av_opt_get_int(avctx->priv_data, "skip_factor",     0, &skip_factor);
+    av_opt_get_int(avctx->priv_data, "noise_reduction", 0, &noise_reduction);
+    av_opt_get_int(avctx->priv_data, "mpv_flags",       0, &mpv_flags);
+    strict_gop = av_opt_find(avctx->priv_data, "strict_gop", "mpv_flags", 0, 0);
+#if FF_API_PRIVATE_OPT
+FF_DISABLE_DEPRECATION_WARNINGS
+    b_strategy      |= avctx->b_frame_strategy;
+    skip_threshold  |= avctx->frame_skip_threshold;
+    skip_factor     |= avctx->frame_skip_factor;
+    noise_reduction |= avctx->noise_reduction;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+
+    if (b_strategy || skip_threshold || skip_factor || noise_reduction ||
+        (strict_gop && (mpv_flags & strict_gop->default_val.i64))) {
+        av_log(avctx, AV_LOG_ERROR,
+               "Frame multi-threading of closed GOPs needs GOPs which are coded "
+               "independently of the previous ones, it does not support "
+               "b_strategy, skip_threshold, skip_factor, noise_reduction and "
+               "strict_gop. Use -thread_type slice.\n");
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static int encode_gop(ThreadContext *c, AVFifoBuffer *frames, int64_t first_frame,
+                      int64_t first_dts, AVFifoBuffer *packets)
+{
+    AVCodecContext *avctx = clone_context(c->gop_template);
+    AVDictionary *tmp = NULL;
+    int64_t tc_start, drop_frame;
+    int nb_packets = 0;
+    int ret;
+
+    if (!avctx)
+        return AVERROR(ENOMEM);
+
+    av_dict_copy(&tmp, c->options, 0);
+    av_dict_set(&tmp, "threads", "1", 0);
+    av_dict_set(&tmp, "g", NULL, 0);
+
+    /* continue the GOP timecodes of the parent, which are counted from the
+     * coded picture number */
+    if (   av_opt_get_int(c->parent_avctx->priv_data, "timecode_frame_start", 0, &tc_start) >= 0
+        && av_opt_get_int(c->parent_avctx->priv_data, "drop_frame_timecode", 0, &drop_frame) >= 0) {
+        av_opt_set(avctx->priv_data, "gop_timecode", NULL, 0);
+        av_opt_set_int(avctx->priv_data, "timecode_frame_start", tc_start + first_frame, 0);
+        av_opt_set_int(avctx->priv_data, "drop_frame_timecode", drop_frame, 0);
+        av_dict_set(&tmp, "gop_timecode", NULL, 0);
+        av_dict_set(&tmp, "timecode_frame_start", NULL, 0);
+        av_dict_set(&tmp, "drop_frame_timecode", NULL, 0);
+#if FF_API_PRIVATE_OPT
+FF_DISABLE_DEPRECATION_WARNINGS
+        avctx->timecode_frame_start = 0;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+    }
+
+    ret = avcodec_open2(avctx, avctx->codec, &tmp);
+    av_dict_free(&tmp);
+    if (ret < 0) {
+        /* avcodec_open2() already freed priv_data and cleared codec */
+        av_freep(&avctx);
+        return ret;
+    }
+
+    for (;;) {
+        AVFrame *frame = NULL;
+        AVPacket pkt;
+        int got_packet, flush;
+
+        if (av_fifo_size(frames) > 0)
+            av_fifo_generic_read(frames, &frame, sizeof(frame), NULL);
+        flush = !frame;
+
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+        ret = avcodec_encode_video2(avctx, &pkt, frame, &got_packet);
+        if (frame) {
+            pthread_mutex_lock(&c->buffer_mutex);
+            av_frame_unref(frame);
+            pthread_mutex_unlock(&c->buffer_mutex);
+            av_frame_free(&frame);
+        }
+        if (ret < 0)
+            break;
+
+        if (got_packet) {
+            /* The first packet is decoded after the last reference frame of
+             * the previous GOP, which this encoder has not seen. */
+            if (!nb_packets++ && avctx->has_b_frames && first_dts != AV_NOPTS_VALUE)
+                pkt.dts = first_dts;
+
+            if ((ret = av_dup_packet(&pkt)) < 0 ||
+                (av_fifo_space(packets) < sizeof(pkt) &&
+                 (ret = av_fifo_grow(packets, sizeof(pkt))) < 0)) {
+                av_packet_unref(&pkt);
+                break;
+            }
+            av_fifo_generic_write(packets, &pkt, sizeof(pkt), NULL);
+        } else if (flush)
+            break;
+    }
+
+    pthread_mutex_lock(&c->buffer_mutex);
+    avcodec_close(avctx);
+    pthread_mutex_unlock(&c->buffer_mutex);
+    av_freep(&avctx);
+
+    return ret;
+}
+
+static void * attribute_align_arg gop_worker(void *v){
+    ThreadContext *c = v;
+    AVFifoBuffer *packets = NULL;
+
+    while(!c->exit){
+        AVFifoBuffer *frames;
+        Task task;
+        int ret;
+
+        if(!packets) packets = av_fifo_alloc_array(c->gop_size, sizeof(AVPacket));
+        if(!packets) continue;
+
+        pthread_mutex_lock(&c->task_fifo_mutex);
+        while (av_fifo_size(c->task_fifo) <= 0 || c->exit) {
+            if(c->exit){
+                pthread_mutex_unlock(&c->task_fifo_mutex);
+                goto end;
+            }
+            pthread_cond_wait(&c->task_fifo_cond, &c->task_fifo_mutex);
+        }
+        av_fifo_generic_read(c->task_fifo, &task, sizeof(task), NULL);
+        pthread_mutex_unlock(&c->task_fifo_mutex);
+
+        frames = task.indata;
+        ret = encode_gop(c, frames, task.first_frame, task.first_dts, packets);
+        free_gop_frames(c, &frames);
+
+        pthread_mutex_lock(&c->finished_task_mutex);
+        c->finished_tasks[task.index].outdata = packets; packets = NULL;
+        c->finished_tasks[task.index].return_code = ret;
+        pthread_cond_signal(&c->finished_task_cond);
+        pthread_mutex_unlock(&c->finished_task_mutex);
+    }
+end:
+    av_fifo_freep(&packets);
+    return NULL;
+}
+
 static void * attribute_align_arg worker(void *v){
     AVCodecContext *avctx = v;
     ThreadContext *c = avctx->internal->frame_thread_encoder;
@@ -84,7 +356,10 @@ static void * attribute_align_arg worker(void *v){
         pthread_mutex_unlock(&c->task_fifo_mutex);
         frame = task.indata;
 
-        ret = avcodec_encode_video2(avctx, pkt, frame, &got_packet);
+        if (avctx->codec_type == AVMEDIA_TYPE_AUDIO)
+            ret = avcodec_encode_audio2(avctx, pkt, frame, &got_packet);
+        else
+            ret = avcodec_encode_video2(avctx, pkt, frame, &got_packet);
         pthread_mutex_lock(&c->buffer_mutex);
         av_frame_unref(frame);
         pthread_mutex_unlock(&c->buffer_mutex);
@@ -113,14 +388,20 @@ end:
 }
 
 int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
-    int i=0;
+    int i=0, ret;
+    int gop_mode = 0;
     ThreadContext *c;
 
 
-    if(   !(avctx->thread_type & FF_THREAD_FRAME)
-       || !(avctx->codec->capabilities & AV_CODEC_CAP_INTRA_ONLY))
+    if(!(avctx->thread_type & FF_THREAD_FRAME))
         return 0;
 
+    if(!(avctx->codec->capabilities & AV_CODEC_CAP_INTRA_ONLY)) {
+        gop_mode = gops_are_independent(avctx);
+        if (!gop_mode)
+            return 0;
+    }
+
     if(   !avctx->thread_count
        && avctx->codec_id == AV_CODEC_ID_MJPEG
        && !(avctx->flags & AV_CODEC_FLAG_QSCALE)) {
@@ -171,6 +452,9 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     if(avctx->thread_count > MAX_THREADS)
         return AVERROR(EINVAL);
 
+    if (gop_mode && (ret = check_gop_settings(avctx)) < 0)
+        return ret;
+
     av_assert0(!avctx->internal->frame_thread_encoder);
     c = avctx->internal->frame_thread_encoder = av_mallocz(sizeof(ThreadContext));
     if(!c)
@@ -188,24 +472,32 @@ int ff_frame_thread_encoder_init(AVCodecContext *avctx, AVDictionary *options){
     pthread_cond_init(&c->task_fifo_cond, NULL);
     pthread_cond_init(&c->finished_task_cond, NULL);
 
+    if (gop_mode) {
+        /* A closed GOP ends before the group of B-frames and their reference
+         * which would reach gop_size, so it holds a whole number of groups.
+         * Whether the last group of the stream joins the GOP before it is
+         * known once the frames a group can span have arrived after it. */
+        c->gop_size      = 1 + (avctx->max_b_frames + 1) *
+                           ((avctx->gop_size - 1) / (avctx->max_b_frames + 1));
+        c->gop_lookahead = avctx->max_b_frames + 1;
+        c->gop_template = clone_context(avctx);
+        if (!c->gop_template || av_dict_copy(&c->options, options, 0) < 0)
+            goto fail;
+
+        for (i = 0; i < avctx->thread_count; i++)
+            if (pthread_create(&c->worker[i], NULL, gop_worker, c))
+                goto fail;
+
+        avctx->active_thread_type = FF_THREAD_FRAME;
+
+        return 0;
+    }
+
     for(i=0; i<avctx->thread_count ; i++){
         AVDictionary *tmp = NULL;
-        void *tmpv;
-        AVCodecContext *thread_avctx = avcodec_alloc_context3(avctx->codec);
+        AVCodecContext *thread_avctx = clone_context(avctx);
         if(!thread_avctx)
             goto fail;
-        tmpv = thread_avctx->priv_data;
-        *thread_avctx = *avctx;
-        thread_avctx->priv_data = tmpv;
-        thread_avctx->internal = NULL;
-        if (avctx->codec->priv_class) {
-            int ret = av_opt_copy(thread_avctx->priv_data, avctx->priv_data);
-            if (ret < 0)
-                goto fail;
-        } else
-            memcpy(thread_avctx->priv_data, avctx->priv_data, avctx->codec->priv_data_size);
-        thread_avctx->thread_count = 1;
-        thread_avctx->active_thread_type &= ~FF_THREAD_FRAME;
 
         av_dict_copy(&tmp, options, 0);
         av_dict_set(&tmp, "threads", "1", 0);
@@ -244,6 +536,26 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx){
          pthread_join(c->worker[i], NULL);
     }
 
+    if (c->gop_template) {
+        Task task;
+
+        while (av_fifo_size(c->task_fifo) > 0) {
+            AVFifoBuffer *frames;
+
+            av_fifo_generic_read(c->task_fifo, &task, sizeof(task), NULL);
+            frames = task.indata;
+            free_gop_frames(c, &frames);
+        }
+        for (i = 0; i < BUFFER_SIZE; i++) {
+            AVFifoBuffer *packets = c->finished_tasks[i].outdata;
+            free_gop_packets(&packets);
+        }
+        free_gop_frames(c, &c->gop_frames);
+        free_gop_packets(&c->gop_packets);
+        free_unopened_context(&c->gop_template);
+        av_dict_free(&c->options);
+    }
+
     pthread_mutex_destroy(&c->task_fifo_mutex);
     pthread_mutex_destroy(&c->finished_task_mutex);
     pthread_mutex_destroy(&c->buffer_mutex);
@@ -253,13 +565,129 @@ void ff_frame_thread_encoder_free(AVCodecContext *avctx){
     av_freep(&avctx->internal->frame_thread_encoder);
 }
 
-int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet_ptr){
+/* submit the first nb_frames gathered frames, keep the rest for the next GOP */
+static int submit_gop(ThreadContext *c, int nb_frames)
+{
+    AVFifoBuffer *frames = c->gop_frames;
+    AVFrame *first = *(AVFrame **)av_fifo_peek2(frames, 0), *last;
+    Task task;
+
+    /* the same dts as a single encoder: the pts of the last reference frame,
+     * which ends the previous closed GOP, or the pts minus the first frame
+     * duration at the start */
+    if (c->gop_first_frame) {
+        task.first_dts = c->gop_last_pts;
+    } else if (av_fifo_size(frames) > sizeof(AVFrame *)) {
+        AVFrame *second = *(AVFrame **)av_fifo_peek2(frames, sizeof(AVFrame *));
+        task.first_dts = first->pts == AV_NOPTS_VALUE || second->pts == AV_NOPTS_VALUE ?
+                         AV_NOPTS_VALUE : 2 * first->pts - second->pts;
+    } else
+        task.first_dts = first->pts;
+
+    if (av_fifo_size(frames) > nb_frames * sizeof(AVFrame *)) {
+        int i;
+
+        frames = av_fifo_alloc_array(nb_frames, sizeof(AVFrame *));
+        if (!frames)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < nb_frames; i++) {
+            AVFrame *frame;
+            av_fifo_generic_read(c->gop_frames, &frame, sizeof(frame), NULL);
+            av_fifo_generic_write(frames, &frame, sizeof(frame), NULL);
+        }
+    } else
+        c->gop_frames = NULL;
+    last = *(AVFrame **)av_fifo_peek2(frames, (nb_frames - 1) * sizeof(AVFrame *));
+    c->gop_last_pts = last->pts;
+
+    task.index       = c->task_index;
+    task.indata      = frames;
+    task.first_frame = c->gop_first_frame;
+    c->gop_first_frame += nb_frames;
+
+    pthread_mutex_lock(&c->task_fifo_mutex);
+    av_fifo_generic_write(c->task_fifo, &task, sizeof(task), NULL);
+    pthread_cond_signal(&c->task_fifo_cond);
+    pthread_mutex_unlock(&c->task_fifo_mutex);
+
+    c->task_index = (c->task_index+1) % BUFFER_SIZE;
+
+    return 0;
+}
+
+static int gop_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet_ptr){
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    Task task;
+    int ret;
+
+    if(frame){
+        AVFrame *new;
+
+        if (!c->gop_frames) {
+            c->gop_frames = av_fifo_alloc_array(c->gop_size + c->gop_lookahead,
+                                                sizeof(new));
+            if (!c->gop_frames)
+                return AVERROR(ENOMEM);
+        }
+        new = av_frame_alloc();
+        if(!new)
+            return AVERROR(ENOMEM);
+        ret = av_frame_ref(new, frame);
+        if(ret < 0) {
+            av_frame_free(&new);
+            return ret;
+        }
+        av_fifo_generic_write(c->gop_frames, &new, sizeof(new), NULL);
+
+        if (!av_fifo_space(c->gop_frames) && (ret = submit_gop(c, c->gop_size)) < 0)
+            return ret;
+    } else if (c->gop_frames) {
+        /* the encoder cuts the remaining frames into GOPs like a single one */
+        ret = submit_gop(c, av_fifo_size(c->gop_frames) / sizeof(AVFrame *));
+        if (ret < 0)
+            return ret;
+    }
+
+    while (!c->gop_packets || av_fifo_size(c->gop_packets) <= 0) {
+        av_fifo_freep(&c->gop_packets);
+
+        pthread_mutex_lock(&c->finished_task_mutex);
+        if (c->task_index == c->finished_task_index ||
+            (frame && !c->finished_tasks[c->finished_task_index].outdata &&
+             (c->task_index - c->finished_task_index) % BUFFER_SIZE <= avctx->thread_count)) {
+            pthread_mutex_unlock(&c->finished_task_mutex);
+            return 0;
+        }
+
+        while (!c->finished_tasks[c->finished_task_index].outdata) {
+            pthread_cond_wait(&c->finished_task_cond, &c->finished_task_mutex);
+        }
+        task = c->finished_tasks[c->finished_task_index];
+        c->finished_tasks[c->finished_task_index].outdata = NULL;
+        c->finished_task_index = (c->finished_task_index+1) % BUFFER_SIZE;
+        pthread_mutex_unlock(&c->finished_task_mutex);
+
+        c->gop_packets = task.outdata;
+        if (task.return_code < 0)
+            return task.return_code;
+    }
+
+    av_fifo_generic_read(c->gop_packets, pkt, sizeof(*pkt), NULL);
+    *got_packet_ptr = 1;
+
+    return 0;
+}
+
+int ff_thread_encode_frame(AVCodecContext *avctx, AVPacket *pkt, const AVFrame *frame, int *got_packet_ptr){
     ThreadContext *c = avctx->internal->frame_thread_encoder;
     Task task;
     int ret;
 
     av_assert1(!*got_packet_ptr);
 
+    if (c->gop_template)
+        return gop_encode_frame(avctx, pkt, frame, got_packet_ptr);
+
     if(frame){
         AVFrame *new = av_frame_alloc();
         if(!new)
@@ -1279,12 +1279,12 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+static int mjpeg_decode_scan_mbs(MJpegDecodeContext *s, int nb_components,
+                                 int Ah, int Al, const uint8_t *mb_bitmask,
+                                 const AVFrame *reference,
+                                 int mb_start, int mb_end)
 {
-    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int i, mb, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
@@ -1292,11 +1292,8 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
     int bytes_per_pixel = 1 + (s->bits > 8);
 
     if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
         init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+        skip_bits_long(&mb_bitmask_gb, mb_start);
     }
 
     s->restart_count = 0;
@@ -1311,95 +1308,196 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    for (mb = mb_start; mb < mb_end; mb++) {
+        const int mb_x = mb % s->mb_width;
+        const int mb_y = mb / s->mb_width;
+        const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
 
-            if (s->restart_interval && !s->restart_count)
-                s->restart_count = s->restart_interval;
+        if (s->restart_interval && !s->restart_count)
+            s->restart_count = s->restart_interval;
+
+        if (get_bits_left(&s->gb) < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
+                   -get_bits_left(&s->gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < nb_components; i++) {
+            uint8_t *ptr;
+            int n, h, v, x, y, c, j;
+            int block_offset;
+            n = s->nb_blocks[i];
+            c = s->comp_index[i];
+            h = s->h_scount[i];
+            v = s->v_scount[i];
+            x = 0;
+            y = 0;
+            for (j = 0; j < n; j++) {
+                block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
+                                 (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += linesize[c] >> 1;
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
+                    ptr = data[c] + block_offset;
+                } else
+                    ptr = NULL;
+                if (!s->progressive) {
+                    if (copy_mb) {
+                        if (ptr)
+                            mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
+                                            linesize[c], s->avctx->lowres);
 
-            if (get_bits_left(&s->gb) < 0) {
-                av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
-                       -get_bits_left(&s->gb));
-                return AVERROR_INVALIDDATA;
-            }
-            for (i = 0; i < nb_components; i++) {
-                uint8_t *ptr;
-                int n, h, v, x, y, c, j;
-                int block_offset;
-                n = s->nb_blocks[i];
-                c = s->comp_index[i];
-                h = s->h_scount[i];
-                v = s->v_scount[i];
-                x = 0;
-                y = 0;
-                for (j = 0; j < n; j++) {
-                    block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
-                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
-
-                    if (s->interlaced && s->bottom_field)
-                        block_offset += linesize[c] >> 1;
-                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
-                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
-                        ptr = data[c] + block_offset;
-                    } else
-                        ptr = NULL;
-                    if (!s->progressive) {
-                        if (copy_mb) {
-                            if (ptr)
-                                mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
-                                                linesize[c], s->avctx->lowres);
-
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
-                        }
                     } else {
-                        int block_idx  = s->block_stride[c] * (v * mb_y + y) +
-                                         (h * mb_x + x);
-                        int16_t *block = s->blocks[c][block_idx];
-                        if (Ah)
-                            block[0] += get_bits1(&s->gb) *
-                                        s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
-                                                       s->quant_matrixes[s->quant_sindex[i]],
-                                                       Al) < 0) {
+                        s->bdsp.clear_block(s->block);
+                        if (decode_block(s, s->block, i,
+                                         s->dc_index[i], s->ac_index[i],
+                                         s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR,
                                    "error y=%d x=%d\n", mb_y, mb_x);
                             return AVERROR_INVALIDDATA;
                         }
+                        if (ptr) {
+                            s->idsp.idct_put(ptr, linesize[c], s->block);
+                            if (s->bits & 7)
+                                shift_output(s, ptr, linesize[c]);
+                        }
                     }
-                    ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
-                    ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
-                            mb_x, mb_y, x, y, c, s->bottom_field,
-                            (v * mb_y + y) * 8, (h * mb_x + x) * 8);
-                    if (++x == h) {
-                        x = 0;
-                        y++;
+                } else {
+                    int block_idx  = s->block_stride[c] * (v * mb_y + y) +
+                                     (h * mb_x + x);
+                    int16_t *block = s->blocks[c][block_idx];
+                    if (Ah)
+                        block[0] += get_bits1(&s->gb) *
+                                    s->quant_matrixes[s->quant_sindex[i]][0] << Al;
+                    else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                                                   s->quant_matrixes[s->quant_sindex[i]],
+                                                   Al) < 0) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
                     }
                 }
+                ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
+                ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
+                        mb_x, mb_y, x, y, c, s->bottom_field,
+                        (v * mb_y + y) * 8, (h * mb_x + x) * 8);
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
             }
-
-            handle_rstn(s, nb_components);
         }
+
+        handle_rstn(s, nb_components);
     }
     return 0;
 }
 
+typedef struct MJpegScanArgs {
+    int nb_components, Ah, Al;
+    const uint8_t *mb_bitmask;
+    const AVFrame *reference;
+    int data_start, data_end;
+    int nb_intervals, nb_jobs;
+} MJpegScanArgs;
+
+/* Decode the MCUs of a range of consecutive restart intervals. Every
+ * interval starts with freshly reset DC predictors, so the ranges can be
+ * decoded independently; within a range, handle_rstn() steps over the RSTn
+ * markers as in the serial path. */
+static int mjpeg_decode_scan_slice(AVCodecContext *avctx, void *arg,
+                                   int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    MJpegDecodeContext *t = &s->slice_ctx[threadnr];
+    const MJpegScanArgs *args = arg;
+    int first  =  jobnr      * args->nb_intervals / args->nb_jobs;
+    int last   = (jobnr + 1) * args->nb_intervals / args->nb_jobs - 1;
+    int start  = first           ? s->rst_pos[first - 1] : args->data_start;
+    int end    = last < s->nb_rst ? s->rst_pos[last]      : args->data_end;
+    int mb_end = FFMIN((last + 1) * s->restart_interval,
+                       s->mb_width * s->mb_height);
+    int i, ret;
+
+    *t = *s;
+    if ((ret = init_get_bits8(&t->gb, s->gb.buffer + start, end - start)) < 0)
+        return ret;
+    for (i = 0; i < args->nb_components; i++)
+        t->last_dc[i] = (4 << t->bits);
+
+    ret = mjpeg_decode_scan_mbs(t, args->nb_components, args->Ah, args->Al,
+                                args->mb_bitmask, args->reference,
+                                first * s->restart_interval, mb_end);
+    emms_c();
+    return ret;
+}
+
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    int i, nb_intervals;
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    nb_intervals = s->restart_interval ?
+                   (s->mb_width * s->mb_height + s->restart_interval - 1) / s->restart_interval : 0;
+
+    /* Only split the scan if exactly one RSTn marker was found between each
+     * pair of restart intervals (some encoders also put one after the last
+     * interval), otherwise decode it serially and let handle_rstn()
+     * resynchronize. */
+    if (s->avctx->active_thread_type & FF_THREAD_SLICE && nb_intervals > 1 &&
+        (s->nb_rst == nb_intervals - 1 || s->nb_rst == nb_intervals) &&
+        s->gb.buffer == s->buffer &&
+        s->rst_pos[0] > get_bits_count(&s->gb) >> 3) {
+        MJpegScanArgs args = {
+            .nb_components = nb_components,
+            .Ah            = Ah,
+            .Al            = Al,
+            .mb_bitmask    = mb_bitmask,
+            .reference     = reference,
+            .data_start    = get_bits_count(&s->gb) >> 3,
+            .data_end      = (get_bits_count(&s->gb) + get_bits_left(&s->gb)) >> 3,
+            .nb_intervals  = nb_intervals,
+            /* one contiguous range of intervals per thread, so that the
+             * context is copied once per thread and not once per interval */
+            .nb_jobs       = FFMIN(nb_intervals, s->avctx->thread_count),
+        };
+
+        av_fast_malloc(&s->slice_ctx, &s->slice_ctx_size,
+                       s->avctx->thread_count * sizeof(*s->slice_ctx));
+        av_fast_malloc(&s->slice_ret, &s->slice_ret_size,
+                       args.nb_jobs * sizeof(*s->slice_ret));
+        if (!s->slice_ctx || !s->slice_ret)
+            return AVERROR(ENOMEM);
+
+        s->avctx->execute2(s->avctx, mjpeg_decode_scan_slice, &args,
+                           s->slice_ret, args.nb_jobs);
+        skip_bits_long(&s->gb, get_bits_left(&s->gb));
+
+        for (i = 0; i < args.nb_jobs; i++)
+            if (s->slice_ret[i] < 0)
+                return s->slice_ret[i];
+        return 0;
+    }
+
+    return mjpeg_decode_scan_mbs(s, nb_components, Ah, Al, mb_bitmask,
+                                 reference, 0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -1984,6 +2082,7 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
 {
     int start_code;
     start_code = find_marker(buf_ptr, buf_end);
+    s->nb_rst  = 0;
 
     av_fast_padded_malloc(&s->buffer, &s->buffer_size, buf_end - *buf_ptr);
     if (!s->buffer)
@@ -2028,6 +2127,18 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         src--;
                     }
 
+                    /* remember where each restart interval starts, so that
+                     * they can be decoded in parallel */
+                    if (x >= 0xd0 && x <= 0xd7 &&
+                        s->avctx->active_thread_type & FF_THREAD_SLICE) {
+                        int *rst_pos = av_fast_realloc(s->rst_pos, &s->rst_pos_size,
+                                                       (s->nb_rst + 1) * sizeof(*s->rst_pos));
+                        if (!rst_pos)
+                            return AVERROR(ENOMEM);
+                        s->rst_pos = rst_pos;
+                        s->rst_pos[s->nb_rst++] = (dst - s->buffer) + (ptr - src);
+                    }
+
                     if (x < 0xd0 || x > 0xd7) {
                         copy_data_segment(1);
                         if (x)
@@ -2536,6 +2647,9 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
 
     av_freep(&s->buffer);
     av_freep(&s->stereo3d);
+    av_freep(&s->rst_pos);
+    av_freep(&s->slice_ctx);
+    av_freep(&s->slice_ret);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
 
@@ -2583,7 +2697,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE |
@@ -111,6 +111,14 @@ typedef struct MJpegDecodeContext {
     int restart_interval;
     int restart_count;
 
+    int *rst_pos;               ///< byte offsets of the data following each RSTn marker of the current scan
+    unsigned int rst_pos_size;
+    int nb_rst;
+    struct MJpegDecodeContext *slice_ctx; ///< per-thread copies for decoding restart intervals in parallel
+    unsigned int slice_ctx_size;
+    int *slice_ret;
+    unsigned int slice_ret_size;
+
     int buggy_avid;
     int cs_itu601;
     int interlace_polarity;
@@ -220,7 +220,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             return ret;
         s->drop_frame_timecode = !!(s->tc.flags & AV_TIMECODE_FLAG_DROPFRAME);
         s->timecode_frame_start = s->tc.start;
-    } else {
+    } else if (s->timecode_frame_start < 0) {
         s->timecode_frame_start = 0; // default is -1
     }
 
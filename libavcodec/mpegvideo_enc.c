@@ -3694,6 +3694,35 @@ static void merge_context_after_encode(MpegEncContext *dst, MpegEncContext *src)
     flush_put_bits(&dst->pb);
 }
 
+/**
+ * Forget the motion vectors and f/b_codes of the previous frames, which the
+ * motion estimation starts from. Done at the start of closed GOPs, so that
+ * they are coded the same way whether or not the previous GOP was encoded
+ * first, as the frame threaded encoding of closed GOPs requires.
+ */
+static void reset_motion_est_history(MpegEncContext *s)
+{
+    int size = ((s->mb_height + 2) * s->mb_stride + 1) * 2 * sizeof(int16_t);
+    int i, j, k;
+
+    s->f_code = 1;
+    s->b_code = 1;
+
+    memset(s->b_forw_mv_table_base,       0, size);
+    memset(s->b_back_mv_table_base,       0, size);
+    memset(s->b_bidir_forw_mv_table_base, 0, size);
+    memset(s->b_bidir_back_mv_table_base, 0, size);
+    memset(s->b_direct_mv_table_base,     0, size);
+    for (i = 0; i < 2; i++)
+        for (j = 0; j < 2; j++) {
+            for (k = 0; k < 2; k++)
+                if (s->b_field_mv_table_base[i][j][k])
+                    memset(s->b_field_mv_table_base[i][j][k], 0, size);
+            if (s->p_field_mv_table_base[i][j])
+                memset(s->p_field_mv_table_base[i][j], 0, size);
+        }
+}
+
 static int estimate_qp(MpegEncContext *s, int dry_run){
     if (s->next_lambda){
         s->current_picture_ptr->f->quality =
@@ -3829,6 +3858,9 @@ static int encode_picture(MpegEncContext *s, int picture_number)
         for(i=0; i<s->mb_stride*s->mb_height; i++)
             s->mb_type[i]= CANDIDATE_MB_TYPE_INTRA;
 
+        if (s->avctx->flags & AV_CODEC_FLAG_CLOSED_GOP)
+            reset_motion_est_history(s);
+
         if(!s->fixed_qscale){
             /* finding spatial complexity for I-frame rate control */
             s->avctx->execute(s->avctx, mb_var_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
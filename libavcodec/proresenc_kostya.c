@@ -195,12 +195,16 @@ typedef struct ProresThreadData {
     struct TrellisNode *nodes;
 } ProresThreadData;
 
+typedef struct ProresRowData {
+    uint8_t *buf;       ///< coded slices of the row, with their headers
+    unsigned buf_size;
+    int size;
+    int ret;
+} ProresRowData;
+
 typedef struct ProresContext {
     AVClass *class;
-    DECLARE_ALIGNED(16, int16_t, blocks)[MAX_PLANES][64 * 4 * MAX_MBS_PER_SLICE];
-    DECLARE_ALIGNED(16, uint16_t, emu_buf)[16*16];
     int16_t quants[MAX_STORED_Q][64];
-    int16_t custom_q[64];
     const uint8_t *quant_mat;
     const uint8_t *scantable;
 
@@ -231,8 +235,11 @@ typedef struct ProresContext {
     const struct prores_profile *profile_info;
 
     int *slice_q;
+    int *slice_size;
+    int max_coded_slice_size;
 
     ProresThreadData *tdata;
+    ProresRowData *rows;
 } ProresContext;
 
 static void get_slice_data(ProresContext *ctx, const uint16_t *src,
@@ -516,7 +523,7 @@ static int encode_alpha_plane(ProresContext *ctx, PutBitContext *pb,
 static int encode_slice(AVCodecContext *avctx, const AVFrame *pic,
                         PutBitContext *pb,
                         int sizes[4], int x, int y, int quant,
-                        int mbs_per_slice)
+                        int mbs_per_slice, ProresThreadData *td)
 {
     ProresContext *ctx = avctx->priv_data;
     int i, xp, yp;
@@ -538,7 +545,7 @@ static int encode_slice(AVCodecContext *avctx, const AVFrame *pic,
     } else if (quant < MAX_STORED_Q) {
         qmat = ctx->quants[quant];
     } else {
-        qmat = ctx->custom_q;
+        qmat = td->custom_q;
         for (i = 0; i < 64; i++)
             qmat[i] = ctx->quant_mat[i] * quant;
     }
@@ -567,18 +574,18 @@ static int encode_slice(AVCodecContext *avctx, const AVFrame *pic,
         if (i < 3) {
             get_slice_data(ctx, src, linesize, xp, yp,
                            pwidth, avctx->height / ctx->pictures_per_frame,
-                           ctx->blocks[0], ctx->emu_buf,
+                           td->blocks[0], td->emu_buf,
                            mbs_per_slice, num_cblocks, is_chroma);
             sizes[i] = encode_slice_plane(ctx, pb, src, linesize,
-                                          mbs_per_slice, ctx->blocks[0],
+                                          mbs_per_slice, td->blocks[0],
                                           num_cblocks, plane_factor,
                                           qmat);
         } else {
             get_alpha_data(ctx, src, linesize, xp, yp,
                            pwidth, avctx->height / ctx->pictures_per_frame,
-                           ctx->blocks[0], mbs_per_slice, ctx->alpha_bits);
+                           td->blocks[0], mbs_per_slice, ctx->alpha_bits);
             sizes[i] = encode_alpha_plane(ctx, pb, mbs_per_slice,
-                                          ctx->blocks[0], quant);
+                                          td->blocks[0], quant);
         }
         total_size += sizes[i];
         if (put_bits_left(pb) < 0) {
@@ -936,16 +943,72 @@ static int find_quant_thread(AVCodecContext *avctx, void *arg,
     return 0;
 }
 
+/**
+ * Choose the quantisers of a slice row and encode its slices into the row
+ * buffer, so that writing the bitstream is done in the slice threads too.
+ */
+static int encode_row_thread(AVCodecContext *avctx, void *arg,
+                             int jobnr, int threadnr)
+{
+    ProresContext *ctx = avctx->priv_data;
+    ProresThreadData *td = ctx->tdata + threadnr;
+    ProresRowData *row = ctx->rows + jobnr;
+    int mbs_per_slice = ctx->mbs_per_slice;
+    int slice_hdr_size = 2 + 2 * (ctx->num_planes - 1);
+    int sizes[4] = { 0 };
+    int x, y = jobnr, i, mb, q, slice_size, ret;
+    uint8_t *buf, *slice_hdr;
+    PutBitContext pb;
+
+    if (!ctx->force_quant)
+        find_quant_thread(avctx, arg, jobnr, threadnr);
+
+    row->size = 0;
+    for (x = mb = 0; x < ctx->mb_width; x += mbs_per_slice, mb++) {
+        q = ctx->force_quant ? ctx->force_quant
+                             : ctx->slice_q[mb + y * ctx->slices_width];
+
+        while (ctx->mb_width - x < mbs_per_slice)
+            mbs_per_slice >>= 1;
+
+        if (row->buf_size < row->size + ctx->max_coded_slice_size) {
+            buf = av_fast_realloc(row->buf, &row->buf_size,
+                                  row->size + ctx->max_coded_slice_size);
+            if (!buf)
+                return row->ret = AVERROR(ENOMEM);
+            row->buf = buf;
+        }
+        buf = row->buf + row->size;
+
+        bytestream_put_byte(&buf, slice_hdr_size << 3);
+        slice_hdr = buf;
+        buf += slice_hdr_size - 1;
+        init_put_bits(&pb, buf, row->buf_size - (buf - row->buf));
+        ret = encode_slice(avctx, ctx->pic, &pb, sizes, x, y, q,
+                           mbs_per_slice, td);
+        if (ret < 0)
+            return row->ret = ret;
+
+        bytestream_put_byte(&slice_hdr, q);
+        slice_size = slice_hdr_size + sizes[ctx->num_planes - 1];
+        for (i = 0; i < ctx->num_planes - 1; i++) {
+            bytestream_put_be16(&slice_hdr, sizes[i]);
+            slice_size += sizes[i];
+        }
+        ctx->slice_size[mb + y * ctx->slices_width] = slice_size;
+        row->size += slice_size;
+    }
+
+    return row->ret = 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pic, int *got_packet)
 {
     ProresContext *ctx = avctx->priv_data;
-    uint8_t *orig_buf, *buf, *slice_hdr, *slice_sizes, *tmp;
+    uint8_t *orig_buf, *buf, *slice_sizes, *tmp;
     uint8_t *picture_size_pos;
-    PutBitContext pb;
-    int x, y, i, mb, q = 0;
-    int sizes[4] = { 0 };
-    int slice_hdr_size = 2 + 2 * (ctx->num_planes - 1);
+    int x, y, i;
     int frame_size, picture_size, slice_size;
     int pkt_size, ret;
     int max_slice_size = (ctx->frame_size_upper_bound - 200) / (ctx->pictures_per_frame * ctx->slices_per_picture + 1);
@@ -1011,75 +1074,59 @@ static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
         buf += ctx->slices_per_picture * 2;
 
         // slices
-        if (!ctx->force_quant) {
-            ret = avctx->execute2(avctx, find_quant_thread, (void*)pic, NULL,
-                                  ctx->mb_height);
-            if (ret)
-                return ret;
-        }
+        ret = avctx->execute2(avctx, encode_row_thread, (void*)pic, NULL,
+                              ctx->mb_height);
+        if (ret)
+            return ret;
 
         for (y = 0; y < ctx->mb_height; y++) {
-            int mbs_per_slice = ctx->mbs_per_slice;
-            for (x = mb = 0; x < ctx->mb_width; x += mbs_per_slice, mb++) {
-                q = ctx->force_quant ? ctx->force_quant
-                                     : ctx->slice_q[mb + y * ctx->slices_width];
-
-                while (ctx->mb_width - x < mbs_per_slice)
-                    mbs_per_slice >>= 1;
-
-                bytestream_put_byte(&buf, slice_hdr_size << 3);
-                slice_hdr = buf;
-                buf += slice_hdr_size - 1;
-                if (pkt_size <= buf - orig_buf + 2 * max_slice_size) {
-                    uint8_t *start = pkt->data;
-                    // Recompute new size according to max_slice_size
-                    // and deduce delta
-                    int delta = 200 + (ctx->pictures_per_frame *
-                                ctx->slices_per_picture + 1) *
-                                max_slice_size - pkt_size;
-
-                    delta = FFMAX(delta, 2 * max_slice_size);
-                    ctx->frame_size_upper_bound += delta;
-
-                    if (!ctx->warn) {
-                        avpriv_request_sample(avctx,
-                                              "Packet too small: is %i,"
-                                              " needs %i (slice: %i). "
-                                              "Correct allocation",
-                                              pkt_size, delta, max_slice_size);
-                        ctx->warn = 1;
-                    }
-
-                    ret = av_grow_packet(pkt, delta);
-                    if (ret < 0)
-                        return ret;
-
-                    pkt_size += delta;
-                    // restore pointers
-                    orig_buf         = pkt->data + (orig_buf         - start);
-                    buf              = pkt->data + (buf              - start);
-                    picture_size_pos = pkt->data + (picture_size_pos - start);
-                    slice_sizes      = pkt->data + (slice_sizes      - start);
-                    slice_hdr        = pkt->data + (slice_hdr        - start);
-                    tmp              = pkt->data + (tmp              - start);
-                }
-                init_put_bits(&pb, buf, (pkt_size - (buf - orig_buf)));
-                ret = encode_slice(avctx, pic, &pb, sizes, x, y, q,
-                                   mbs_per_slice);
-                if (ret < 0)
-                    return ret;
+            ProresRowData *row = ctx->rows + y;
 
-                bytestream_put_byte(&slice_hdr, q);
-                slice_size = slice_hdr_size + sizes[ctx->num_planes - 1];
-                for (i = 0; i < ctx->num_planes - 1; i++) {
-                    bytestream_put_be16(&slice_hdr, sizes[i]);
-                    slice_size += sizes[i];
-                }
+            if (row->ret < 0)
+                return row->ret;
+
+            for (x = 0; x < ctx->slices_width; x++) {
+                slice_size = ctx->slice_size[x + y * ctx->slices_width];
                 bytestream_put_be16(&slice_sizes, slice_size);
-                buf += slice_size - slice_hdr_size;
                 if (max_slice_size < slice_size)
                     max_slice_size = slice_size;
             }
+
+            if (pkt_size <= buf - orig_buf + row->size) {
+                uint8_t *start = pkt->data;
+                // Recompute new size according to max_slice_size
+                // and deduce delta
+                int delta = 200 + (ctx->pictures_per_frame *
+                            ctx->slices_per_picture + 1) *
+                            max_slice_size - pkt_size;
+
+                delta = FFMAX(delta, 2 * max_slice_size);
+                delta = FFMAX(delta, row->size);
+                ctx->frame_size_upper_bound += delta;
+
+                if (!ctx->warn) {
+                    avpriv_request_sample(avctx,
+                                          "Packet too small: is %i,"
+                                          " needs %i (slice: %i). "
+                                          "Correct allocation",
+                                          pkt_size, delta, max_slice_size);
+                    ctx->warn = 1;
+                }
+
+                ret = av_grow_packet(pkt, delta);
+                if (ret < 0)
+                    return ret;
+
+                pkt_size += delta;
+                // restore pointers
+                orig_buf         = pkt->data + (orig_buf         - start);
+                buf              = pkt->data + (buf              - start);
+                picture_size_pos = pkt->data + (picture_size_pos - start);
+                slice_sizes      = pkt->data + (slice_sizes      - start);
+                tmp              = pkt->data + (tmp              - start);
+            }
+            memcpy(buf, row->buf, row->size);
+            buf += row->size;
         }
 
         picture_size = buf - (picture_size_pos - 1);
@@ -1107,7 +1154,13 @@ static av_cold int encode_close(AVCodecContext *avctx)
             av_freep(&ctx->tdata[i].nodes);
     }
     av_freep(&ctx->tdata);
+    if (ctx->rows) {
+        for (i = 0; i < ctx->mb_height; i++)
+            av_freep(&ctx->rows[i].buf);
+    }
+    av_freep(&ctx->rows);
     av_freep(&ctx->slice_q);
+    av_freep(&ctx->slice_size);
 
     return 0;
 }
@@ -1208,6 +1261,14 @@ FF_ENABLE_DEPRECATION_WARNINGS
         return AVERROR_INVALIDDATA;
     }
 
+    ctx->tdata      = av_mallocz_array(avctx->thread_count, sizeof(*ctx->tdata));
+    ctx->rows       = av_mallocz_array(ctx->mb_height, sizeof(*ctx->rows));
+    ctx->slice_size = av_malloc_array(ctx->slices_per_picture, sizeof(*ctx->slice_size));
+    if (!ctx->tdata || !ctx->rows || !ctx->slice_size) {
+        encode_close(avctx);
+        return AVERROR(ENOMEM);
+    }
+
     ctx->force_quant = avctx->global_quality / FF_QP2LAMBDA;
     if (!ctx->force_quant) {
         if (!ctx->bits_per_mb) {
@@ -1236,12 +1297,6 @@ FF_ENABLE_DEPRECATION_WARNINGS
             return AVERROR(ENOMEM);
         }
 
-        ctx->tdata = av_mallocz(avctx->thread_count * sizeof(*ctx->tdata));
-        if (!ctx->tdata) {
-            encode_close(avctx);
-            return AVERROR(ENOMEM);
-        }
-
         for (j = 0; j < avctx->thread_count; j++) {
             ctx->tdata[j].nodes = av_malloc((ctx->slices_width + 1)
                                             * TRELLIS_WIDTH
@@ -1288,6 +1343,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
          /* bits per pixel */            (1 + ctx->alpha_bits + 1) + 7 >> 3);
     }
 
+    /* A coefficient takes at most 72 bits with its run, level and sign. */
+    ctx->max_coded_slice_size = 2 + 2 * ctx->num_planes +
+                                mps * 64 * (4 + 2 * (2 << (ctx->chroma_factor == CFACTOR_Y444))) * 9;
+    if (ctx->alpha_bits)
+        ctx->max_coded_slice_size += mps * 256 * (1 + ctx->alpha_bits + 1) + 7 >> 3;
+
     avctx->codec_tag   = ctx->profile_info->tag;
 
     av_log(avctx, AV_LOG_DEBUG,
@@ -86,6 +86,7 @@ typedef struct PerThreadContext {
     AVFrame *frame;                 ///< Output frame (for decoding) or input (for encoding).
     int     got_frame;              ///< The output of got_picture_ptr from the last avcodec_decode_video() call.
     int     result;                 ///< The result of the last codec decode/encode() call.
+    int     output_pending;         ///< Set while the output of the submitted packet has not been returned.
 
     atomic_int state;
 
@@ -468,12 +469,78 @@ static int submit_packet(PerThreadContext *p, AVCodecContext *user_avctx,
         }
     }
 
+    p->output_pending = 1;
     fctx->prev_thread = p;
     fctx->next_decoding++;
 
     return 0;
 }
 
+/**
+ * Wait for the thread to finish decoding and move its output to picture.
+ *
+ * @return the result of the decode() call of the thread
+ */
+static int get_thread_output(PerThreadContext *p, AVFrame *picture,
+                             int *got_picture_ptr)
+{
+    int err;
+
+    if (atomic_load(&p->state) != STATE_INPUT_READY) {
+        pthread_mutex_lock(&p->progress_mutex);
+        while (atomic_load_explicit(&p->state, memory_order_relaxed) != STATE_INPUT_READY)
+            pthread_cond_wait(&p->output_cond, &p->progress_mutex);
+        pthread_mutex_unlock(&p->progress_mutex);
+    }
+
+    av_frame_move_ref(picture, p->frame);
+    *got_picture_ptr = p->got_frame;
+    picture->pkt_dts = p->avpkt.dts;
+    err = p->result;
+
+    /*
+     * A later call with avkpt->size == 0 may loop over all threads,
+     * including this one, searching for a frame/error to return before being
+     * stopped by the "finished != fctx->next_finished" condition.
+     * Make sure we don't mistakenly return the same frame/error again.
+     */
+    p->got_frame      = 0;
+    p->result         = 0;
+    p->output_pending = 0;
+
+    return err;
+}
+
+/**
+ * Return the output of the oldest thread and make it available for a new
+ * packet.
+ */
+static int get_oldest_output(AVCodecContext *avctx, AVFrame *picture,
+                             int *got_picture_ptr)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    PerThreadContext *p = &fctx->threads[fctx->next_finished];
+    int err;
+
+    err = get_thread_output(p, picture, got_picture_ptr);
+    update_context_from_thread(avctx, p->avctx, 1);
+
+    if (++fctx->next_finished >= avctx->thread_count)
+        fctx->next_finished = 0;
+
+    return err;
+}
+
+static int nb_pending_outputs(AVCodecContext *avctx)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+
+    if (!fctx->threads[fctx->next_finished].output_pending)
+        return 0;
+    return (fctx->next_decoding - fctx->next_finished + avctx->thread_count - 1) %
+           avctx->thread_count + 1;
+}
+
 int ff_thread_decode_frame(AVCodecContext *avctx,
                            AVFrame *picture, int *got_picture_ptr,
                            AVPacket *avpkt)
@@ -488,10 +555,32 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     async_unlock(fctx);
 
     /*
-     * Submit a packet to the next decoding thread.
+     * ff_thread_receive_frame() may have left all threads busy, in which
+     * case the oldest one has to return its frame before it can be reused.
+     * At the end of the stream that thread may not have output a frame, so
+     * continue with the other threads instead of signaling EOF.
      */
 
     p = &fctx->threads[fctx->next_decoding];
+    if (p->output_pending) {
+        err = get_oldest_output(avctx, picture, got_picture_ptr);
+        if (avpkt->size || *got_picture_ptr || err < 0) {
+            int ret = submit_packet(p, avctx, avpkt);
+            if (fctx->next_decoding >= avctx->thread_count)
+                fctx->next_decoding = 0;
+            if (ret < 0)
+                err = ret;
+            if (err >= 0)
+                err = avpkt->size;
+            goto finish;
+        }
+        finished = fctx->next_finished;
+    }
+
+    /*
+     * Submit a packet to the next decoding thread.
+     */
+
     err = submit_packet(p, avctx, avpkt);
     if (err)
         goto finish;
@@ -521,26 +610,7 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     do {
         p = &fctx->threads[finished++];
 
-        if (atomic_load(&p->state) != STATE_INPUT_READY) {
-            pthread_mutex_lock(&p->progress_mutex);
-            while (atomic_load_explicit(&p->state, memory_order_relaxed) != STATE_INPUT_READY)
-                pthread_cond_wait(&p->output_cond, &p->progress_mutex);
-            pthread_mutex_unlock(&p->progress_mutex);
-        }
-
-        av_frame_move_ref(picture, p->frame);
-        *got_picture_ptr = p->got_frame;
-        picture->pkt_dts = p->avpkt.dts;
-        err = p->result;
-
-        /*
-         * A later call with avkpt->size == 0 may loop over all threads,
-         * including this one, searching for a frame/error to return before being
-         * stopped by the "finished != fctx->next_finished" condition.
-         * Make sure we don't mistakenly return the same frame/error again.
-         */
-        p->got_frame = 0;
-        p->result = 0;
+        err = get_thread_output(p, picture, got_picture_ptr);
 
         if (finished >= avctx->thread_count) finished = 0;
     } while (!avpkt->size && !*got_picture_ptr && err >= 0 && finished != fctx->next_finished);
@@ -559,6 +629,54 @@ finish:
     return err;
 }
 
+int ff_thread_receive_frame(AVCodecContext *avctx, AVFrame *picture,
+                            int *got_picture_ptr, AVPacket *avpkt, int block)
+{
+    FrameThreadContext *fctx = avctx->internal->thread_ctx;
+    int max_pending = avctx->thread_count - (avctx->codec_id == AV_CODEC_ID_FFV1);
+    int submit = avpkt->data || avpkt->size;
+    int err = 0, ret;
+
+    *got_picture_ptr = 0;
+
+    /*
+     * A frame is only returned once all threads are busy, so that the
+     * packets the frames are returned after do not depend on the timing
+     * of the threads. Only wait for the oldest one if the caller allows it;
+     * the packet stays queued in the caller otherwise.
+     */
+
+    if (nb_pending_outputs(avctx) >= max_pending) {
+        if (!block)
+            return AVERROR(EAGAIN);
+
+        /* the initial packets have been submitted, ff_thread_decode_frame()
+         * must return frames from now on if it is used to drain the threads */
+        fctx->delaying = 0;
+
+        async_unlock(fctx);
+        err = get_oldest_output(avctx, picture, got_picture_ptr);
+    } else if (submit) {
+        async_unlock(fctx);
+    } else
+        return AVERROR(EAGAIN);
+
+    if (submit) {
+        ret = submit_packet(&fctx->threads[fctx->next_decoding], avctx, avpkt);
+        if (fctx->next_decoding >= avctx->thread_count)
+            fctx->next_decoding = 0;
+        if (ret < 0)
+            err = ret;
+    }
+
+    /* return the size of the consumed packet if no error occurred */
+    if (err >= 0)
+        err = submit ? avpkt->size : 0;
+
+    async_lock(fctx);
+    return err;
+}
+
 void ff_thread_report_progress(ThreadFrame *f, int n, int field)
 {
     PerThreadContext *p;
@@ -866,6 +984,7 @@ void ff_thread_flush(AVCodecContext *avctx)
         p->got_frame = 0;
         av_frame_unref(p->frame);
         p->result = 0;
+        p->output_pending = 0;
 
         release_delayed_buffers(p);
 
@@ -61,6 +61,21 @@ void ff_thread_flush(AVCodecContext *avctx);
 int ff_thread_decode_frame(AVCodecContext *avctx, AVFrame *picture,
                            int *got_picture_ptr, AVPacket *avpkt);
 
+/**
+ * Non-blocking variant of ff_thread_decode_frame() for the
+ * avcodec_send_packet()/avcodec_receive_frame() API.
+ * Submits avpkt to an idle decoding thread without waiting for any output.
+ * Once all threads are busy, the frame of the oldest one is returned in
+ * picture if block is set, waiting for it to be decoded if needed.
+ *
+ * @param avpkt the packet to submit, or an empty packet to only return a frame
+ * @return the size of the consumed packet (0 if avpkt was empty) or a decoding
+ *         error, AVERROR(EAGAIN) if nothing can be done without waiting
+ *         or there is neither a packet to submit nor a frame to return
+ */
+int ff_thread_receive_frame(AVCodecContext *avctx, AVFrame *picture,
+                            int *got_picture_ptr, AVPacket *avpkt, int block);
+
 /**
  * If the codec defines update_thread_context(), call this
  * when they are ready for the next thread to start decoding
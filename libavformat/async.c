@@ -1,5 +1,5 @@
 /*
- * Input async protocol.
+ * Input/output async protocol.
  * Copyright (c) 2015 Zhang Rui <bbcallen@gmail.com>
  *
  * This file is part of FFmpeg.
@@ -34,6 +34,7 @@
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "url.h"
 #include <stdint.h>
 
@@ -78,6 +79,13 @@ typedef struct Context {
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    /* write mode */
+    int             write_buffer_size;
+    int             write_eof;
+    int             max_backlog;
+    int             nb_stalls;
+    int64_t         stall_time;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -237,6 +245,57 @@ static void *async_buffer_task(void *arg)
     return NULL;
 }
 
+static void *async_write_task(void *arg)
+{
+    URLContext   *h    = arg;
+    Context      *c    = h->priv_data;
+    AVFifoBuffer *fifo = c->ring.fifo;
+    int           ret;
+
+    pthread_mutex_lock(&c->mutex);
+    while (1) {
+        uint8_t *rptr;
+        int size;
+
+        if (async_check_interrupt(h)) {
+            c->io_error = AVERROR_EXIT;
+            break;
+        }
+
+        size = av_fifo_size(fifo);
+        if (!size) {
+            if (c->write_eof)
+                break;
+            pthread_cond_signal(&c->cond_wakeup_main);
+            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+            continue;
+        }
+
+        /* Write all contiguous buffered data in one go. The main thread only
+         * ever appends to the fifo, so this part stays valid while the lock
+         * is released. */
+        rptr = fifo->rptr;
+        size = FFMIN(size, fifo->end - rptr);
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = ffurl_write(c->inner, rptr, size);
+
+        pthread_mutex_lock(&c->mutex);
+        if (ret < 0) {
+            c->io_error = ret;
+            break;
+        }
+        av_fifo_drain(fifo, size);
+        pthread_cond_signal(&c->cond_wakeup_main);
+    }
+
+    c->io_eof_reached = 1;
+    pthread_cond_signal(&c->cond_wakeup_main);
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
 static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     Context         *c = h->priv_data;
@@ -245,7 +304,15 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    if ((flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_READ_WRITE) {
+        av_log(h, AV_LOG_ERROR, "Simultaneous reading and writing is not supported\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (flags & AVIO_FLAG_WRITE)
+        ret = ring_init(&c->ring, c->write_buffer_size, 0);
+    else
+        ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
     if (ret < 0)
         goto fifo_fail;
 
@@ -257,6 +324,14 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
         goto url_fail;
     }
 
+    /* writes are coalesced, which would break packet boundaries */
+    if (flags & AVIO_FLAG_WRITE && c->inner->max_packet_size &&
+        c->inner->prot->flags & URL_PROTOCOL_FLAG_NETWORK) {
+        av_log(h, AV_LOG_ERROR, "Packet based protocols are not supported for writing\n");
+        ret = AVERROR(EINVAL);
+        goto mutex_fail;
+    }
+
     c->logical_size = ffurl_size(c->inner);
     h->is_streamed  = c->inner->is_streamed;
 
@@ -278,7 +353,8 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
         goto cond_wakeup_background_fail;
     }
 
-    ret = pthread_create(&c->async_buffer_thread, NULL, async_buffer_task, h);
+    ret = pthread_create(&c->async_buffer_thread, NULL,
+                         flags & AVIO_FLAG_WRITE ? async_write_task : async_buffer_task, h);
     if (ret) {
         av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", av_err2str(ret));
         goto thread_fail;
@@ -306,7 +382,11 @@ static int async_close(URLContext *h)
     int      ret;
 
     pthread_mutex_lock(&c->mutex);
-    c->abort_request = 1;
+    /* let the writer thread empty the buffer before it exits */
+    if (h->flags & AVIO_FLAG_WRITE)
+        c->write_eof = 1;
+    else
+        c->abort_request = 1;
     pthread_cond_signal(&c->cond_wakeup_background);
     pthread_mutex_unlock(&c->mutex);
 
@@ -314,13 +394,20 @@ static int async_close(URLContext *h)
     if (ret != 0)
         av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(ret));
 
+    ret = 0;
+    if (h->flags & AVIO_FLAG_WRITE) {
+        av_log(h, AV_LOG_VERBOSE, "Largest backlog %d bytes, stalled %d times for %"PRId64" ms\n",
+               c->max_backlog, c->nb_stalls, c->stall_time / 1000);
+        ret = c->io_error;
+    }
+
     pthread_cond_destroy(&c->cond_wakeup_background);
     pthread_cond_destroy(&c->cond_wakeup_main);
     pthread_mutex_destroy(&c->mutex);
     ffurl_close(c->inner);
     ring_destroy(&c->ring);
 
-    return 0;
+    return ret;
 }
 
 static int async_read_internal(URLContext *h, void *dest, int size, int read_complete,
@@ -375,6 +462,84 @@ static int async_read(URLContext *h, unsigned char *buf, int size)
     return async_read_internal(h, buf, size, 0, NULL);
 }
 
+static int async_write(URLContext *h, const unsigned char *buf, int size)
+{
+    Context      *c           = h->priv_data;
+    AVFifoBuffer *fifo        = c->ring.fifo;
+    int64_t       stall_start = 0;
+    int           written     = 0;
+    int           ret         = 0;
+
+    pthread_mutex_lock(&c->mutex);
+
+    while (written < size) {
+        int to_copy;
+        if (c->io_error) {
+            ret = c->io_error;
+            break;
+        }
+        if (async_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        to_copy = FFMIN(size - written, av_fifo_space(fifo));
+        if (to_copy > 0) {
+            av_fifo_generic_write(fifo, (void *)(buf + written), to_copy, NULL);
+            written        += to_copy;
+            c->max_backlog  = FFMAX(c->max_backlog, av_fifo_size(fifo));
+            pthread_cond_signal(&c->cond_wakeup_background);
+            continue;
+        }
+        /* the buffer is full, wait for the writer thread to catch up */
+        if (!stall_start) {
+            stall_start = av_gettime_relative();
+            c->nb_stalls++;
+        }
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+
+    if (stall_start)
+        c->stall_time += av_gettime_relative() - stall_start;
+
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret < 0 ? ret : written;
+}
+
+/* Wait for all buffered data to be written, must be called with the lock held. */
+static int async_write_drain(URLContext *h)
+{
+    Context *c = h->priv_data;
+
+    while (av_fifo_size(c->ring.fifo)) {
+        if (c->io_error)
+            return c->io_error;
+        if (async_check_interrupt(h))
+            return AVERROR_EXIT;
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+
+    return c->io_error;
+}
+
+static int64_t async_write_seek(URLContext *h, int64_t pos, int whence)
+{
+    Context *c = h->priv_data;
+    int64_t  ret;
+
+    pthread_mutex_lock(&c->mutex);
+    ret = async_write_drain(h);
+    /* the writer thread is idle with an empty buffer, so the inner
+     * context can be used directly */
+    if (ret >= 0)
+        ret = ffurl_seek(c->inner, pos, whence);
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
 static void fifo_do_not_copy_func(void* dest, void* src, int size) {
     // do not copy
 }
@@ -388,6 +553,9 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
     int fifo_size;
     int fifo_size_of_read_back;
 
+    if (h->flags & AVIO_FLAG_WRITE)
+        return async_write_seek(h, pos, whence);
+
     if (whence == AVSEEK_SIZE) {
         av_log(h, AV_LOG_TRACE, "async_seek: AVSEEK_SIZE: %"PRId64"\n", (int64_t)c->logical_size);
         return c->logical_size;
@@ -463,13 +631,15 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 }
 
 #define OFFSET(x) offsetof(Context, x)
-#define D AV_OPT_FLAG_DECODING_PARAM
+#define E AV_OPT_FLAG_ENCODING_PARAM
 
 static const AVOption options[] = {
+    { "write_buffer_size", "size of the buffer decoupling the writer from the output (in bytes)",
+        OFFSET(write_buffer_size), AV_OPT_TYPE_INT, { .i64 = BUFFER_CAPACITY }, 4096, INT_MAX / 2, E },
     {NULL},
 };
 
-#undef D
+#undef E
 #undef OFFSET
 
 static const AVClass async_context_class = {
@@ -483,6 +653,7 @@ const URLProtocol ff_async_protocol = {
     .name                = "async",
     .url_open2           = async_open,
     .url_read            = async_read,
+    .url_write           = async_write,
     .url_seek            = async_seek,
     .url_close           = async_close,
     .priv_data_size      = sizeof(Context),
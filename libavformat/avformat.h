@@ -1917,6 +1917,26 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int max_streams;
+
+    /**
+     * Number of threads used by avformat_find_stream_info() to decode the
+     * packets of different streams in parallel, 0 for automatic.
+     * With 1, all packets are decoded by the calling thread.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
+
+    /**
+     * Directory where the stream parameters found by
+     * avformat_find_stream_info() and the index of local files are cached,
+     * so that they are not probed again when the same file is opened later.
+     * Entries are only used if the path, size and modification time of the
+     * file match.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *probe_cache;
 } AVFormatContext;
 
 /**
@@ -964,6 +964,17 @@ fail:
     return AVERROR(ENOMEM);
 }
 
+URLContext *ffio_geturlcontext(AVIOContext *s)
+{
+    AVIOInternal *internal;
+
+    if (!s || s->read_packet != io_read_packet)
+        return NULL;
+
+    internal = s->opaque;
+    return internal ? internal->h : NULL;
+}
+
 int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 {
     uint8_t *buffer;
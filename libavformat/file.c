@@ -67,12 +67,19 @@
 
 /* standard file protocol */
 
+/* more than this does not help any storage and only evicts other cached data */
+#define MAX_READAHEAD (256 << 20)
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
     int blocksize;
     int follow;
+    int readahead;
+    int readahead_chunk;
+    int64_t pos;
+    int64_t readahead_end;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -82,6 +89,8 @@ static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead", "set amount of data to request ahead of the read position", offsetof(FileContext, readahead), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, MAX_READAHEAD, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead_chunk", "set minimum size of the readahead requests", offsetof(FileContext, readahead_chunk), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, MAX_READAHEAD, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -104,12 +113,34 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+static void file_readahead(FileContext *c)
+{
+#if HAVE_POSIX_FADVISE
+    /* Keep up to readahead bytes requested from the kernel, so that the data
+     * is on its way while the demuxer processes the current one. Request the
+     * whole missing range at once, but only after at least readahead_chunk
+     * bytes of it were consumed, so that small reads do not each cost a
+     * system call. */
+    int64_t start = FFMAX(c->readahead_end, c->pos);
+    int64_t end   = c->pos + c->readahead;
+
+    if (end - start >= FFMIN(c->readahead_chunk, c->readahead)) {
+        posix_fadvise(c->fd, start, end - start, POSIX_FADV_WILLNEED);
+        c->readahead_end = end;
+    }
+#endif
+}
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->readahead)
+        file_readahead(c);
     ret = read(c->fd, buf, size);
+    if (ret > 0)
+        c->pos += ret;
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
     if (ret == 0)
@@ -234,6 +265,19 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
         h->min_packet_size = h->max_packet_size = 262144;
 
+    if (c->readahead) {
+        if (h->is_streamed || flags & AVIO_FLAG_WRITE) {
+            c->readahead = 0;
+        } else {
+#if HAVE_POSIX_FADVISE
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+            av_log(h, AV_LOG_WARNING, "readahead is not supported on this system\n");
+            c->readahead = 0;
+#endif
+        }
+    }
+
     return 0;
 }
 
@@ -250,6 +294,8 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     }
 
     ret = lseek(c->fd, pos, whence);
+    if (ret >= 0)
+        c->pos = c->readahead_end = ret;
 
     return ret < 0 ? AVERROR(errno) : ret;
 }
@@ -36,6 +36,7 @@
 #include "avformat.h"
 #include "internal.h"
 #include "avio_internal.h"
+#include "http.h"
 #include "id3v2.h"
 
 #define INITIAL_BUFFER_SIZE 32768
@@ -94,6 +95,10 @@ struct playlist {
     AVIOContext pb;
     uint8_t* read_buffer;
     AVIOContext *input;
+    int input_read_done;
+    AVIOContext *input_next;
+    int input_next_requested;
+    int input_next_seq_no;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -205,6 +210,8 @@ typedef struct HLSContext {
     AVDictionary *avio_opts;
     int strict_std_compliance;
     char *allowed_extensions;
+    int http_persistent;
+    int http_multiple;
 } HLSContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -255,6 +262,8 @@ static void free_playlist_list(HLSContext *c)
         av_freep(&pls->pb.buffer);
         if (pls->input)
             ff_format_io_close(c->ctx, &pls->input);
+        if (pls->input_next)
+            ff_format_io_close(c->ctx, &pls->input_next);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -596,6 +605,26 @@ static void update_options(char **dest, const char *name, void *src)
         av_freep(dest);
 }
 
+static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
+                              const char *url, AVDictionary **opts)
+{
+#if !CONFIG_HTTP_PROTOCOL
+    return AVERROR_PROTOCOL_NOT_FOUND;
+#else
+    URLContext *uc = ffio_geturlcontext(*pb);
+    int ret = AVERROR(EINVAL);
+
+    /* only reuse a connection whose previous reply was consumed entirely */
+    if (uc && (*pb)->buf_ptr == (*pb)->buf_end) {
+        (*pb)->eof_reached = 0;
+        ret = ff_http_do_new_request2(uc, url, opts);
+    }
+    if (ret < 0)
+        ff_format_io_close(s, pb);
+    return ret;
+#endif
+}
+
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     AVDictionary *opts, AVDictionary *opts2, int *is_http)
 {
@@ -639,7 +668,21 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
-    ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+    if (*pb && c->http_persistent && av_strstart(url, "http", NULL)) {
+        ret = open_url_keepalive(s, pb, url, &tmp);
+        if (ret == AVERROR_EXIT) {
+            av_dict_free(&tmp);
+            return ret;
+        } else if (ret < 0) {
+            av_log(s, AV_LOG_VERBOSE,
+                   "Cannot reuse connection for '%s', opening a new one: %s\n",
+                   url, av_err2str(ret));
+            ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+        }
+    } else {
+        ff_format_io_close(s, pb);
+        ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+    }
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -1097,7 +1140,8 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
+                      AVIOContext **in)
 {
     AVDictionary *opts = NULL;
     int ret;
@@ -1110,6 +1154,9 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
     av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
     av_dict_set(&opts, "seekable", "0", 0);
 
+    if (c->http_persistent)
+        av_dict_set(&opts, "multiple_requests", "1", 0);
+
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
          * (if this is in fact a HTTP request) */
@@ -1121,12 +1168,12 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = open_url(pls->parent, &pls->input, seg->url, c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, c->avio_opts, opts, &is_http);
     } else if (seg->key_type == KEY_AES_128) {
         AVDictionary *opts2 = NULL;
         char iv[33], key[33], url[MAX_URL_SIZE];
         if (strcmp(seg->key, pls->key_url)) {
-            AVIOContext *pb;
+            AVIOContext *pb = NULL;
             if (open_url(pls->parent, &pb, seg->key, c->avio_opts, opts, NULL) == 0) {
                 ret = avio_read(pb, pls->key, sizeof(pls->key));
                 if (ret != sizeof(pls->key)) {
@@ -1152,7 +1199,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
         av_dict_set(&opts2, "key", key, 0);
         av_dict_set(&opts2, "iv", iv, 0);
 
-        ret = open_url(pls->parent, &pls->input, url, opts2, opts, &is_http);
+        ret = open_url(pls->parent, in, url, opts2, opts, &is_http);
 
         av_dict_free(&opts2);
 
@@ -1179,11 +1226,11 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg)
      * noticed without the call, though.
      */
     if (ret == 0 && !is_http && seg->key_type == KEY_NONE && seg->url_offset) {
-        int64_t seekret = avio_seek(pls->input, seg->url_offset, SEEK_SET);
+        int64_t seekret = avio_seek(*in, seg->url_offset, SEEK_SET);
         if (seekret < 0) {
             av_log(pls->parent, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of HLS segment '%s'\n", seg->url_offset, seg->url);
             ret = seekret;
-            ff_format_io_close(pls->parent, &pls->input);
+            ff_format_io_close(pls->parent, in);
         }
     }
 
@@ -1193,6 +1240,31 @@ cleanup:
     return ret;
 }
 
+static int can_reuse_input(HLSContext *c, struct segment *seg)
+{
+    return c->http_persistent && seg->key_type == KEY_NONE &&
+           av_strstart(seg->url, "http", NULL);
+}
+
+/* Close the input of a segment that has been read, or keep the connection
+ * around so that the request for the next segment can reuse it. */
+static void close_segment_input(HLSContext *c, struct playlist *pls,
+                                struct segment *seg, int ret)
+{
+    if (can_reuse_input(c, seg) && (ret >= 0 || ret == AVERROR_EOF))
+        pls->input_read_done = 1;
+    else
+        ff_format_io_close(pls->parent, &pls->input);
+}
+
+static struct segment *next_segment(struct playlist *pls)
+{
+    int n = pls->cur_seq_no - pls->start_seq_no + 1;
+    if (n >= pls->n_segments)
+        return NULL;
+    return pls->segments[n];
+}
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
     static const int max_init_section_size = 1024*1024;
@@ -1209,7 +1281,7 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     if (!seg->init_section)
         return 0;
 
-    ret = open_input(c, pls, seg->init_section);
+    ret = open_input(c, pls, seg->init_section, &pls->input);
     if (ret < 0) {
         av_log(pls->parent, AV_LOG_WARNING,
                "Failed to open an initialization section in playlist %d\n",
@@ -1234,7 +1306,7 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
 
     ret = read_from_url(pls, seg->init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size, READ_COMPLETE);
-    ff_format_io_close(pls->parent, &pls->input);
+    close_segment_input(c, pls, seg->init_section, ret);
 
     if (ret < 0)
         return ret;
@@ -1268,7 +1340,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input) {
+    if (!v->input || v->input_read_done) {
         int64_t reload_interval;
         struct segment *seg;
 
@@ -1331,7 +1403,15 @@ reload:
         if (ret)
             return ret;
 
-        ret = open_input(c, v, seg);
+        if (v->input_next_requested && v->input_next_seq_no == v->cur_seq_no) {
+            /* the request for this segment was already sent */
+            FFSWAP(AVIOContext *, v->input, v->input_next);
+            v->input_next_requested = 0;
+            v->cur_seg_offset = 0;
+            ret = 0;
+        } else {
+            ret = open_input(c, v, seg, &v->input);
+        }
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
                 return AVERROR_EXIT;
@@ -1340,7 +1420,28 @@ reload:
             v->cur_seq_no += 1;
             goto reload;
         }
+        v->input_read_done = 0;
         just_opened = 1;
+
+        /* Send the request for the next segment on a second connection, so
+         * that its latency overlaps with reading the current one. */
+        seg = next_segment(v);
+        if (c->http_multiple && seg && can_reuse_input(c, seg)) {
+            if (v->input_next_requested)
+                ff_format_io_close(v->parent, &v->input_next);
+            v->input_next_requested = 0;
+            ret = open_input(c, v, seg, &v->input_next);
+            if (ret < 0) {
+                if (ff_check_interrupt(c->interrupt_callback))
+                    return AVERROR_EXIT;
+                av_log(v->parent, AV_LOG_WARNING,
+                       "Failed to prefetch segment %d of playlist %d\n",
+                       v->cur_seq_no + 1, v->index);
+            } else {
+                v->input_next_requested = 1;
+                v->input_next_seq_no    = v->cur_seq_no + 1;
+            }
+        }
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -1361,7 +1462,7 @@ reload:
 
         return ret;
     }
-    ff_format_io_close(v->parent, &v->input);
+    close_segment_input(c, v, current_segment(v), ret);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1864,6 +1965,10 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         } else if (first && !pls->cur_needed && pls->needed) {
             if (pls->input)
                 ff_format_io_close(pls->parent, &pls->input);
+            pls->input_read_done = 0;
+            if (pls->input_next)
+                ff_format_io_close(pls->parent, &pls->input_next);
+            pls->input_next_requested = 0;
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2098,6 +2203,10 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         struct playlist *pls = c->playlists[i];
         if (pls->input)
             ff_format_io_close(pls->parent, &pls->input);
+        pls->input_read_done = 0;
+        if (pls->input_next)
+            ff_format_io_close(pls->parent, &pls->input_next);
+        pls->input_next_requested = 0;
         av_packet_unref(&pls->pkt);
         reset_packet(&pls->pkt);
         pls->pb.eof_reached = 0;
@@ -2150,6 +2259,10 @@ static const AVOption hls_options[] = {
         OFFSET(allowed_extensions), AV_OPT_TYPE_STRING,
         {.str = "3gp,aac,avi,flac,mkv,m3u8,m4a,m4s,m4v,mpg,mov,mp2,mp3,mp4,mpeg,mpegts,ogg,ogv,oga,ts,vob,wav"},
         INT_MIN, INT_MAX, FLAGS},
+    {"http_persistent", "Use persistent HTTP connections",
+        OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS },
+    {"http_multiple", "Use multiple HTTP connections for downloading HTTP segments",
+        OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
     {NULL}
 };
 
@@ -170,6 +170,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *hoststr, const char *auth,
                         const char *proxyauth, int *new_location);
 static int http_read_header(URLContext *h, int *new_location);
+static int http_get_line(HTTPContext *s, char *line, int line_size);
 
 void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
 {
@@ -317,6 +318,59 @@ int ff_http_do_new_request(URLContext *h, const char *uri)
     return ret;
 }
 
+int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    char proto1[10], proto2[10], hostname1[1024], hostname2[1024];
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+    int port1, port2, ret;
+
+    if (!h->prot || strcmp(h->prot->name, "http") && strcmp(h->prot->name, "https"))
+        return AVERROR(EINVAL);
+
+    av_url_split(proto1, sizeof(proto1), NULL, 0, hostname1, sizeof(hostname1),
+                 &port1, NULL, 0, s->location);
+    av_url_split(proto2, sizeof(proto2), NULL, 0, hostname2, sizeof(hostname2),
+                 &port2, NULL, 0, uri);
+    if (strcmp(proto1, proto2) || strcmp(hostname1, hostname2) || port1 != port2)
+        return AVERROR(EINVAL);
+
+    /* the connection can only be reused once the previous reply has been
+     * read completely */
+    if (!s->hd || s->willclose)
+        return AVERROR_EOF;
+    if (s->chunksize != UINT64_MAX) {
+        char line[32];
+
+        if (s->chunksize)
+            return AVERROR(EINVAL);
+        /* skip the trailer following the last chunk */
+        do {
+            if ((ret = http_get_line(s, line, sizeof(line))) < 0)
+                return ret;
+        } while (*line);
+    } else if (target_end == UINT64_MAX || s->off < target_end) {
+        return AVERROR(EINVAL);
+    }
+
+    s->off           = 0;
+    s->end_off       = 0;
+    s->chunksize     = UINT64_MAX;
+    s->icy_data_read = 0;
+    av_free(s->location);
+    s->location = av_strdup(uri);
+    if (!s->location)
+        return AVERROR(ENOMEM);
+
+    if (opts && (ret = av_opt_set_dict(s, opts)) < 0)
+        return ret;
+
+    ret = http_open_cnx(h, &options);
+    av_dict_free(&options);
+    return ret;
+}
+
 int ff_http_averror(int status_code, int default_averror)
 {
     switch (status_code) {
@@ -47,6 +47,19 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src);
  */
 int ff_http_do_new_request(URLContext *h, const char *uri);
 
+/**
+ * Send a new HTTP request for a resource on the same server, reusing the
+ * old connection if the reply to the previous request has been read
+ * completely and the server did not ask for the connection to be closed.
+ *
+ * @param h pointer to the resource
+ * @param uri uri used to perform the request
+ * @param opts options to apply to the new request (e.g. "offset"), may be NULL
+ * @return a negative value if an error condition occurred, in which case
+ * the caller should open a new connection, 0 otherwise
+ */
+int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts);
+
 int ff_http_averror(int status_code, int default_averror);
 
 #endif /* AVFORMAT_HTTP_H */
@@ -150,6 +150,20 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Packets decoded by other threads in avformat_find_stream_info(),
+     * only set while it runs with probe_threads != 1.
+     */
+    struct ProbeDecodeContext *probe_decode;
+
+    /**
+     * Stream parameters of the probe cache entry of the input, and the number
+     * of index entries the entry was last saved or loaded with.
+     */
+    uint8_t *probe_cache_params;
+    int probe_cache_params_size;
+    int64_t probe_cache_index_entries;
 };
 
 struct AVStreamInternal {
@@ -372,6 +386,27 @@ AVChapter *avpriv_new_chapter(AVFormatContext *s, int id, AVRational time_base,
  */
 void ff_reduce_index(AVFormatContext *s, int stream_index);
 
+/**
+ * Restore the stream parameters and index entries of the input from the
+ * probe cache, if it has a valid entry for it.
+ *
+ * @return 1 if they were restored, 0 if the input is not in the cache,
+ *         a negative AVERROR code on error
+ */
+int ff_probe_cache_load(AVFormatContext *s);
+
+/**
+ * Save the stream parameters found by avformat_find_stream_info() and the
+ * index entries of the input to the probe cache.
+ */
+int ff_probe_cache_save(AVFormatContext *s);
+
+/**
+ * Save the probe cache entry of the input again if its index grew since it
+ * was loaded or saved.
+ */
+int ff_probe_cache_update(AVFormatContext *s);
+
 enum AVCodecID ff_guess_image2_codec(const char *filename);
 
 /**
@@ -127,6 +127,34 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Run of chunks with the same number of samples, as used when locating
+ * the samples from the sample tables.
+ */
+typedef struct MOVCompactStsc {
+    unsigned int first_chunk;  ///< 0-based index of the first chunk of the run
+    unsigned int count;        ///< number of samples per chunk
+    unsigned int first_sample; ///< index of the first sample of the run
+} MOVCompactStsc;
+
+/**
+ * Index of a stream built lazily from its stts/stsc/stsz/stco/stss tables,
+ * instead of an AVIndexEntry per sample in AVStream.index_entries.
+ */
+typedef struct MOVCompactIndex {
+    unsigned int nb_samples;
+    int64_t start_dts;         ///< dts of the first sample
+    unsigned int stts_count;   ///< number of stts entries actually used
+    unsigned int *stts_sample; ///< index of the first sample of each stts entry
+    int64_t *stts_dts;         ///< dts of the first sample of each stts entry
+    unsigned int stsc_count;
+    MOVCompactStsc *stsc;
+    int key_off;
+    AVIndexEntry entry;        ///< last entry returned, for entry_sample
+    int entry_sample;
+    int64_t entry_end;         ///< end of entry_sample in the file
+} MOVCompactIndex;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -161,6 +189,7 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+    MOVCompactIndex *compact_index; ///< set if the samples are not in AVStream.index_entries
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -264,6 +293,7 @@ typedef struct MOVContext {
     uint8_t *decryption_key;
     int decryption_key_len;
     int enable_drefs;
+    int compact_index;
     int32_t movie_display_matrix[3][3]; ///< display matrix from mvhd
 } MOVContext;
 
@@ -3329,6 +3329,325 @@ static void mov_fix_index(MOVContext *mov, AVStream *st)
     msc->current_index = msc->index_ranges[0].start;
 }
 
+static void mov_free_compact_index(MOVStreamContext *sc)
+{
+    if (!sc->compact_index)
+        return;
+    av_freep(&sc->compact_index->stts_sample);
+    av_freep(&sc->compact_index->stts_dts);
+    av_freep(&sc->compact_index->stsc);
+    av_freep(&sc->compact_index);
+}
+
+static int64_t mov_compact_index_dts(MOVStreamContext *sc, unsigned int sample)
+{
+    MOVCompactIndex *ci = sc->compact_index;
+    unsigned int lo = 0, hi = ci->stts_count;
+
+    while (hi - lo > 1) {
+        unsigned int mid = (lo + hi) >> 1;
+        if (ci->stts_sample[mid] <= sample)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return ci->stts_dts[lo] + (int64_t)(sample - ci->stts_sample[lo]) * sc->stts_data[lo].duration;
+}
+
+/**
+ * Return the number of samples since the last keyframe, 0 if the sample
+ * is a keyframe itself and sample + 1 if no keyframe precedes it.
+ */
+static unsigned int mov_compact_index_distance(AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVCompactIndex *ci = sc->compact_index;
+    unsigned int lo = 0, hi = sc->keyframe_count, key;
+
+    if (sc->keyframe_absent) {
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO ||
+            (!sample && !ci->stsc[0].first_chunk))
+            return 0;
+        return sample + 1;
+    }
+    if (!sc->keyframe_count)
+        return 0;
+
+    if (sc->keyframes[0] - ci->key_off > sample)
+        return sample + 1;
+    while (hi - lo > 1) {
+        unsigned int mid = (lo + hi) >> 1;
+        if (sc->keyframes[mid] - ci->key_off <= sample)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    key = sc->keyframes[lo] - ci->key_off;
+    return sample - key;
+}
+
+/**
+ * Locate a sample of a stream using a compact index.
+ * The returned entry stays valid until the next call for the same stream.
+ */
+static AVIndexEntry *mov_compact_index_entry(AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVCompactIndex *ci = sc->compact_index;
+    AVIndexEntry *e = &ci->entry;
+    const MOVCompactStsc *run;
+    unsigned int lo = 0, hi = ci->stsc_count, chunk, first, distance, i;
+
+    if (ci->entry_sample == sample)
+        return e;
+
+    while (hi - lo > 1) {
+        unsigned int mid = (lo + hi) >> 1;
+        if (ci->stsc[mid].first_sample <= sample)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    run   = &ci->stsc[lo];
+    chunk = run->first_chunk + (sample - run->first_sample) / run->count;
+    first = sample - (sample - run->first_sample) % run->count;
+
+    if (sample > first && ci->entry_sample == sample - 1) {
+        /* sequential access, continue from the previous sample */
+        e->pos = ci->entry_end;
+    } else {
+        e->pos = sc->chunk_offsets[chunk];
+        if (sc->stsz_sample_size > 0)
+            e->pos += (int64_t)(sample - first) * sc->stsz_sample_size;
+        else
+            for (i = first; i < sample; i++)
+                e->pos += (unsigned)sc->sample_sizes[i];
+    }
+    e->size      = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[sample];
+    e->timestamp = mov_compact_index_dts(sc, sample);
+    ci->entry_end = e->pos + (unsigned)e->size;
+
+    /* the distance of a sample before the first keyframe counts from 0 */
+    distance = mov_compact_index_distance(st, sample);
+    if (distance > sample) {
+        e->min_distance = sample;
+        e->flags        = 0;
+    } else {
+        e->min_distance = distance;
+        e->flags        = distance ? 0 : AVINDEX_KEYFRAME;
+    }
+    ci->entry_sample = sample;
+
+    return e;
+}
+
+/**
+ * Set up a compact index for the stream if all of its samples can be
+ * located from its sample tables in the same way as mov_build_index()
+ * does when filling st->index_entries.
+ *
+ * @return 0 on success, a negative value if the stream needs a full index
+ */
+static int mov_init_compact_index(MOVContext *mov, AVStream *st, int64_t start_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVCompactIndex *ci;
+    unsigned int i, k, chunk, sample;
+    uint64_t total = 0, stream_size = 0;
+    int size_error = 0;
+    int64_t dts = start_dts;
+
+    /* edit lists, partial sync samples, sample groups, samples of other
+     * sample descriptions and negative sample deltas all need the
+     * sequential pass of the full index */
+    if ((sc->elst_count && !mov->ignore_editlist && mov->advanced_editlist) ||
+        sc->stps_count || sc->rap_group_count ||
+        !sc->chunk_count || !sc->stts_count || !sc->stsc_count ||
+        (sc->sample_size > 0 && sc->stsz_sample_size > 0 &&
+         sc->sample_size != sc->stsz_sample_size))
+        return AVERROR(ENOSYS);
+    for (i = 0; i < sc->stts_count; i++)
+        if (sc->stts_data[i].duration < 0)
+            return AVERROR(ENOSYS);
+    for (i = 0; i < sc->stsc_count; i++)
+        if (sc->stsc_data[i].count < 0 ||
+            (sc->pseudo_stream_id != -1 && sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return AVERROR(ENOSYS);
+    for (i = 0; i < sc->keyframe_count; i++)
+        if (sc->keyframes[i] < 0 || (i && sc->keyframes[i] <= sc->keyframes[i - 1]))
+            return AVERROR(ENOSYS);
+
+    ci = av_mallocz(sizeof(*ci));
+    if (!ci)
+        return AVERROR(ENOMEM);
+    sc->compact_index = ci;
+    ci->stsc        = av_malloc_array(sc->stsc_count, sizeof(*ci->stsc));
+    ci->stts_sample = av_malloc_array(sc->stts_count, sizeof(*ci->stts_sample));
+    ci->stts_dts    = av_malloc_array(sc->stts_count, sizeof(*ci->stts_dts));
+    if (!ci->stsc || !ci->stts_sample || !ci->stts_dts) {
+        mov_free_compact_index(sc);
+        return AVERROR(ENOMEM);
+    }
+    ci->entry_sample = -1;
+    ci->start_dts    = start_dts;
+    ci->key_off      = sc->keyframe_count && sc->keyframes[0] > 0;
+
+    /* runs of chunks sharing a stsc entry, skipping entries that are never
+     * reached because their first chunk is not after the previous one */
+    for (chunk = 0, k = 0; chunk < sc->chunk_count;) {
+        unsigned int next = sc->chunk_count;
+
+        while (mov_stsc_index_valid(k, sc->stsc_count) &&
+               chunk + 1 == sc->stsc_data[k + 1].first)
+            k++;
+        if (mov_stsc_index_valid(k, sc->stsc_count) &&
+            sc->stsc_data[k + 1].first > chunk + 1)
+            next = FFMIN(sc->stsc_data[k + 1].first - 1, sc->chunk_count);
+
+        if (sc->stsc_data[k].count && total < sc->sample_count) {
+            MOVCompactStsc *run = &ci->stsc[ci->stsc_count++];
+            run->first_chunk  = chunk;
+            run->count        = sc->stsc_data[k].count;
+            run->first_sample = total;
+        }
+        total += (uint64_t)(next - chunk) * sc->stsc_data[k].count;
+        chunk  = next;
+    }
+    ci->nb_samples = FFMIN3(total, sc->sample_count, INT_MAX);
+
+    for (sample = 0; sample < ci->nb_samples; sample++) {
+        unsigned int size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[sample];
+        if (size > 0x3FFFFFFF) {
+            av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", size);
+            ci->nb_samples = sample;
+            size_error = 1;
+            break;
+        }
+        stream_size += size;
+    }
+    if (total > sc->sample_count)
+        av_log(mov->fc, AV_LOG_ERROR, "wrong sample count\n");
+    else if (!size_error && st->duration > 0)
+        st->codecpar->bit_rate = stream_size * 8 * sc->time_scale / st->duration;
+
+    /* an stts entry without samples is never left */
+    for (i = 0, sample = 0; i < sc->stts_count; i++) {
+        ci->stts_sample[i] = sample;
+        ci->stts_dts[i]    = dts;
+        ci->stts_count     = i + 1;
+        if (!sc->stts_data[i].count ||
+            (uint64_t)sample + sc->stts_data[i].count >= ci->nb_samples)
+            break;
+        sample += sc->stts_data[i].count;
+        dts    += (int64_t)sc->stts_data[i].count * sc->stts_data[i].duration;
+    }
+
+    if (!ci->nb_samples || !ci->stsc_count) {
+        mov_free_compact_index(sc);
+        return 0;
+    }
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (sample = 0; sample < FFMIN(ci->nb_samples, 99); sample++)
+            ff_rfps_add_frame(mov->fc, st, mov_compact_index_dts(sc, sample));
+
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d: compact index of %u samples\n",
+           st->index, ci->nb_samples);
+
+    return 0;
+}
+
+/**
+ * Replace the compact index of a stream by AVStream.index_entries, for the
+ * code which needs to modify the index.
+ */
+static int mov_expand_compact_index(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    unsigned int i;
+
+    if (!sc->compact_index)
+        return 0;
+
+    if (av_reallocp_array(&st->index_entries, sc->compact_index->nb_samples,
+                          sizeof(*st->index_entries)) < 0) {
+        st->nb_index_entries = 0;
+        mov_free_compact_index(sc);
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < sc->compact_index->nb_samples; i++)
+        st->index_entries[i] = *mov_compact_index_entry(st, i);
+    st->nb_index_entries = sc->compact_index->nb_samples;
+    st->index_entries_allocated_size = st->nb_index_entries * sizeof(*st->index_entries);
+    mov_free_compact_index(sc);
+
+    return 0;
+}
+
+static int mov_nb_index_entries(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    return sc->compact_index ? sc->compact_index->nb_samples : st->nb_index_entries;
+}
+
+static AVIndexEntry *mov_get_index_entry(AVStream *st, int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->compact_index)
+        return mov_compact_index_entry(st, sample);
+    return &st->index_entries[sample];
+}
+
+static int64_t mov_get_index_timestamp(AVStream *st, int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->compact_index)
+        return mov_compact_index_dts(sc, sample);
+    return st->index_entries[sample].timestamp;
+}
+
+/**
+ * Same as av_index_search_timestamp(), for streams with a compact index too.
+ */
+static int mov_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int nb_entries, a, b, m;
+    int64_t timestamp;
+
+    if (!sc->compact_index)
+        return av_index_search_timestamp(st, wanted_timestamp, flags);
+
+    /* compact indexes have no discarded samples and are sorted by dts */
+    nb_entries = sc->compact_index->nb_samples;
+    a = -1;
+    b = nb_entries;
+    if (b && mov_compact_index_dts(sc, b - 1) < wanted_timestamp)
+        a = b - 1;
+
+    while (b - a > 1) {
+        m         = (a + b) >> 1;
+        timestamp = mov_compact_index_dts(sc, m);
+        if (timestamp >= wanted_timestamp)
+            b = m;
+        if (timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < nb_entries &&
+               !(mov_compact_index_entry(st, m)->flags & AVINDEX_KEYFRAME))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+
+    if (m == nb_entries)
+        return -1;
+    return m;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -3398,6 +3717,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         if (!sc->sample_count || st->nb_index_entries)
             return;
+        if (mov->compact_index && mov_init_compact_index(mov, st, current_dts) >= 0)
+            return;
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) - st->nb_index_entries)
             return;
         if (av_reallocp_array(&st->index_entries,
@@ -3831,11 +4152,13 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
+    /* Do not need those anymore, unless the samples are located from them. */
+    if (!sc->compact_index) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+    }
     av_freep(&sc->stps_data);
     av_freep(&sc->elst_data);
     av_freep(&sc->rap_group);
@@ -4274,6 +4597,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
+    if ((err = mov_expand_compact_index(st)) < 0)
+        return err;
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -5778,6 +6103,8 @@ static void mov_read_chapters(AVFormatContext *s)
 
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
+        if (mov_expand_compact_index(st) < 0)
+            goto finish;
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
@@ -5876,7 +6203,7 @@ static int mov_read_rtmd_track(AVFormatContext *s, AVStream *st)
     int64_t cur_pos = avio_tell(sc->pb);
     int hh, mm, ss, ff, drop;
 
-    if (!st->nb_index_entries)
+    if (mov_expand_compact_index(st) < 0 || !st->nb_index_entries)
         return -1;
 
     avio_seek(sc->pb, st->index_entries->pos, SEEK_SET);
@@ -5901,7 +6228,7 @@ static int mov_read_timecode_track(AVFormatContext *s, AVStream *st)
     int64_t cur_pos = avio_tell(sc->pb);
     uint32_t value;
 
-    if (!st->nb_index_entries)
+    if (mov_expand_compact_index(st) < 0 || !st->nb_index_entries)
         return -1;
 
     avio_seek(sc->pb, st->index_entries->pos, SEEK_SET);
@@ -5957,6 +6284,7 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        mov_free_compact_index(sc);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -6356,8 +6684,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        if (msc->pb && msc->current_sample < mov_nb_index_entries(avst)) {
+            AVIndexEntry *current_sample = mov_get_index_entry(avst, msc->current_sample);
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -6543,8 +6871,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = (sc->current_sample < mov_nb_index_entries(st)) ?
+            mov_get_index_timestamp(st, sc->current_sample) : st->duration;
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
@@ -6621,9 +6949,9 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    sample = mov_index_search_timestamp(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+    if (sample < 0 && mov_nb_index_entries(st) && timestamp < mov_get_index_timestamp(st, 0))
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
@@ -6675,7 +7003,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_get_index_timestamp(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
             int64_t timestamp;
@@ -6753,6 +7081,8 @@ static const AVOption mov_options[] = {
     { "decryption_key", "The media decryption key (hex)", OFFSET(decryption_key), AV_OPT_TYPE_BINARY, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "enable_drefs", "Enable external track support.", OFFSET(enable_drefs), AV_OPT_TYPE_BOOL,
         {.i64 = 0}, 0, 1, FLAGS },
+    { "compact_index", "Locate the samples from the sample tables instead of building a full index",
+        OFFSET(compact_index), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
 
     { NULL },
 };
@@ -159,6 +159,9 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** buffers for PES packets of unbounded size */
+    AVBufferPool *pes_pool;
 };
 
 #define MPEGTS_OPTIONS \
@@ -885,6 +888,20 @@ static void new_data_packet(const uint8_t *buffer, int len, AVPacket *pkt)
     pkt->size = len;
 }
 
+static AVBufferRef *alloc_pes_buffer(MpegTSContext *ts, int total_size)
+{
+    /* unbounded PES packets all get the maximum size, recycle these buffers
+     * instead of allocating and faulting in a large block for each of them */
+    if (total_size == MAX_PES_PAYLOAD) {
+        if (!ts->pes_pool)
+            ts->pes_pool = av_buffer_pool_init(MAX_PES_PAYLOAD +
+                                               AV_INPUT_BUFFER_PADDING_SIZE,
+                                               NULL);
+        return ts->pes_pool ? av_buffer_pool_get(ts->pes_pool) : NULL;
+    }
+    return av_buffer_alloc(total_size + AV_INPUT_BUFFER_PADDING_SIZE);
+}
+
 static int new_pes_packet(PESContext *pes, AVPacket *pkt)
 {
     char *sd;
@@ -1075,8 +1092,7 @@ static int mpegts_push_data(MpegTSFilter *filter,
                         pes->total_size = MAX_PES_PAYLOAD;
 
                     /* allocate pes buffer */
-                    pes->buffer = av_buffer_alloc(pes->total_size +
-                                                  AV_INPUT_BUFFER_PADDING_SIZE);
+                    pes->buffer = alloc_pes_buffer(ts, pes->total_size);
                     if (!pes->buffer)
                         return AVERROR(ENOMEM);
 
@@ -1236,8 +1252,7 @@ skip:
                     if (ret < 0)
                         return ret;
                     pes->total_size = MAX_PES_PAYLOAD;
-                    pes->buffer = av_buffer_alloc(pes->total_size +
-                                                  AV_INPUT_BUFFER_PADDING_SIZE);
+                    pes->buffer = alloc_pes_buffer(ts, pes->total_size);
                     if (!pes->buffer)
                         return AVERROR(ENOMEM);
                     ts->stop_parse = 1;
@@ -2246,14 +2261,13 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 static int parse_pcr(int64_t *ppcr_high, int *ppcr_low,
                      const uint8_t *packet);
 
-/* handle one TS packet */
-static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
+/* handle one TS packet, pos is the byte position just after it or < 0 */
+static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
 {
     MpegTSFilter *tss;
     int len, pid, cc, expected_cc, cc_ok, afc, is_start, is_discontinuity,
         has_adaptation, has_payload;
     const uint8_t *p, *p_end;
-    int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
     if (pid && discard_pid(ts, pid))
@@ -2310,7 +2324,6 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     if (p >= p_end || !has_payload)
         return 0;
 
-    pos = avio_tell(ts->stream->pb);
     if (pos >= 0) {
         av_assert0(pos >= TS_PACKET_SIZE);
         ts->pos47_full = pos - TS_PACKET_SIZE;
@@ -2369,7 +2382,7 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
         // Note: The position here points actually behind the current packet.
         if (tss->type == MPEGTS_PES) {
             if ((ret = tss->u.pes_filter.pes_cb(tss, p, p_end - p, is_start,
-                                                pos - ts->raw_packet_size)) < 0)
+                                                pos >= 0 ? pos - ts->raw_packet_size : -1)) < 0)
                 return ret;
         }
     }
@@ -2477,12 +2490,32 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Count the packets which are already complete in the I/O buffer and all
+ * start with a sync byte, so that they can be handled in place without
+ * going through read_packet() one by one.
+ */
+static int buffered_packets(AVIOContext *pb, int raw_packet_size)
+{
+    const uint8_t *p = pb->buf_ptr;
+    int i, nb;
+
+    if (pb->write_flag)
+        return 0;
+    nb = (pb->buf_end - p) / raw_packet_size;
+    for (i = 0; i < nb; i++, p += raw_packet_size)
+        if (*p != 0x47)
+            break;
+    return i;
+}
+
 static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
-    int64_t packet_num;
+    int64_t packet_num, pos = 0;
+    int nb_buffered = 0;
     int ret = 0;
 
     if (avio_tell(s->pb) != ts->last_pos) {
@@ -2518,11 +2551,26 @@ static int handle_packets(MpegTSContext *ts, int64_t nb_packets)
         if (ts->stop_parse > 0)
             break;
 
-        ret = read_packet(s, packet, ts->raw_packet_size, &data);
-        if (ret != 0)
-            break;
-        ret = handle_packet(ts, data);
-        finished_reading_packet(s, ts->raw_packet_size);
+        if (!nb_buffered) {
+            nb_buffered = buffered_packets(s->pb, ts->raw_packet_size);
+            pos = avio_tell(s->pb);
+        }
+        if (nb_buffered > 0) {
+            /* fast path: the packet is in the buffer and in sync, handle it
+             * in place and keep track of the position ourselves */
+            data = s->pb->buf_ptr;
+            s->pb->buf_ptr += ts->raw_packet_size;
+            nb_buffered--;
+            ret = handle_packet(ts, data, pos < 0 ? pos : pos + TS_PACKET_SIZE);
+            if (pos >= 0)
+                pos += ts->raw_packet_size;
+        } else {
+            ret = read_packet(s, packet, ts->raw_packet_size, &data);
+            if (ret != 0)
+                break;
+            ret = handle_packet(ts, data, avio_tell(s->pb));
+            finished_reading_packet(s, ts->raw_packet_size);
+        }
         if (ret != 0)
             break;
     }
@@ -2804,6 +2852,8 @@ static void mpegts_free(MpegTSContext *ts)
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
             mpegts_close_filter(ts, ts->pids[i]);
+
+    av_buffer_pool_uninit(&ts->pes_pool);
 }
 
 static int mpegts_read_close(AVFormatContext *s)
@@ -2918,7 +2968,7 @@ int avpriv_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
             buf++;
             len--;
         } else {
-            handle_packet(ts, buf);
+            handle_packet(ts, buf, -1);
             buf += TS_PACKET_SIZE;
             len -= TS_PACKET_SIZE;
             if (ts->stop_parse == 1)
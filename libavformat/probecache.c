@@ -0,0 +1,545 @@
+/*
+ * Persistent cache of the stream parameters of local files
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Cache of the results of avformat_find_stream_info() and of the index
+ * entries of local files, stored in one file per input in the directory
+ * set with the probe_cache option. An entry is only used when the path,
+ * size and modification time of the input and the options limiting the
+ * analysis match.
+ *
+ * Layout of a cache file, all numbers big-endian:
+ * - "FFPC", version
+ * - path, size and modification time of the input
+ * - probesize, analyzeduration and fpsprobesize
+ * - size and content of the stream parameters
+ * - number of indexed streams, and for each one its index, number of
+ *   entries and the entries
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/file.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavutil/random_seed.h"
+#include "libavcodec/bytestream.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "os_support.h"
+
+#define PROBE_CACHE_VERSION 2
+
+/* size of the parameters following the extradata of a stream */
+#define STREAM_PARAMS_SIZE 208
+/* size of an index entry */
+#define INDEX_ENTRY_SIZE 25
+
+typedef struct ProbeCacheKey {
+    const char *path;
+    int64_t size;
+    int64_t mtime;
+    int64_t probesize;
+    int64_t max_analyze_duration;
+    int fps_probe_size;
+} ProbeCacheKey;
+
+static int get_key(AVFormatContext *s, ProbeCacheKey *key)
+{
+    const char *proto = avio_find_protocol_name(s->filename);
+    struct stat st;
+
+    if (!s->pb || !proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+
+    key->path = s->filename;
+    av_strstart(key->path, "file:", &key->path);
+    if (stat(key->path, &st) < 0 || !S_ISREG(st.st_mode))
+        return AVERROR(ENOSYS);
+    key->size  = st.st_size;
+    key->mtime = st.st_mtime;
+    key->probesize            = s->probesize;
+    key->max_analyze_duration = s->max_analyze_duration;
+    key->fps_probe_size       = s->fps_probe_size;
+    return 0;
+}
+
+static char *get_cache_path(AVFormatContext *s, const ProbeCacheKey *key)
+{
+    struct AVMD5 *ctx = av_md5_alloc();
+    uint8_t md5[16], options[20];
+    char name[2 * sizeof(md5) + 1];
+    int i;
+
+    if (!ctx)
+        return NULL;
+    /* the same file analyzed with other limits gets its own entry */
+    AV_WB64(options,      key->probesize);
+    AV_WB64(options +  8, key->max_analyze_duration);
+    AV_WB32(options + 16, key->fps_probe_size);
+    av_md5_init(ctx);
+    av_md5_update(ctx, key->path, strlen(key->path));
+    av_md5_update(ctx, options, sizeof(options));
+    av_md5_final(ctx, md5);
+    av_free(ctx);
+    for (i = 0; i < sizeof(md5); i++)
+        snprintf(name + 2 * i, 3, "%02x", md5[i]);
+    return av_asprintf("%s/%s.ffpc", s->probe_cache, name);
+}
+
+/* Only these demuxers build their index while reading packets, the others
+ * either have none or always build it from the header. */
+static int index_is_cached(AVFormatContext *s)
+{
+    return !strcmp(s->iformat->name, "matroska,webm") ||
+           !strcmp(s->iformat->name, "mpegts") ||
+           (s->iformat->flags & AVFMT_GENERIC_INDEX);
+}
+
+static int64_t nb_cached_index_entries(AVFormatContext *s)
+{
+    int64_t nb_entries = 0;
+    int i;
+
+    if (!index_is_cached(s))
+        return 0;
+    for (i = 0; i < s->nb_streams; i++)
+        nb_entries += s->streams[i]->nb_index_entries;
+    return nb_entries;
+}
+
+static void put_string(AVIOContext *pb, const char *str)
+{
+    int len = strlen(str);
+
+    avio_wb32(pb, len);
+    avio_write(pb, str, len);
+}
+
+static void put_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wb32(pb, q.num);
+    avio_wb32(pb, q.den);
+}
+
+static AVRational get_rational(GetByteContext *gb)
+{
+    AVRational q;
+
+    q.num = bytestream2_get_be32(gb);
+    q.den = bytestream2_get_be32(gb);
+    return q;
+}
+
+static int write_params(AVFormatContext *s, uint8_t **buf)
+{
+    AVIOContext *pb;
+    int i, ret;
+
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        return ret;
+
+    put_string(pb, s->iformat->name);
+    avio_wb64(pb, s->start_time);
+    avio_wb64(pb, s->duration);
+    avio_wb64(pb, s->bit_rate);
+    avio_wb32(pb, s->duration_estimation_method);
+    avio_wb32(pb, s->nb_streams);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st            = s->streams[i];
+        AVCodecParameters *par  = st->codecpar;
+        AVCodecContext *avctx   = st->internal->avctx;
+
+        avio_wb32(pb, st->id);
+        avio_wb32(pb, par->codec_type);
+        avio_wb32(pb, par->codec_id);
+        avio_wb32(pb, par->codec_tag);
+        avio_wb32(pb, par->extradata_size);
+        avio_write(pb, par->extradata, par->extradata_size);
+        avio_wb32(pb, par->format);
+        avio_wb64(pb, par->bit_rate);
+        avio_wb32(pb, par->bits_per_coded_sample);
+        avio_wb32(pb, par->bits_per_raw_sample);
+        avio_wb32(pb, par->profile);
+        avio_wb32(pb, par->level);
+        avio_wb32(pb, par->width);
+        avio_wb32(pb, par->height);
+        put_rational(pb, par->sample_aspect_ratio);
+        avio_wb32(pb, par->field_order);
+        avio_wb32(pb, par->color_range);
+        avio_wb32(pb, par->color_primaries);
+        avio_wb32(pb, par->color_trc);
+        avio_wb32(pb, par->color_space);
+        avio_wb32(pb, par->chroma_location);
+        avio_wb32(pb, par->video_delay);
+        avio_wb64(pb, par->channel_layout);
+        avio_wb32(pb, par->channels);
+        avio_wb32(pb, par->sample_rate);
+        avio_wb32(pb, par->block_align);
+        avio_wb32(pb, par->frame_size);
+        avio_wb32(pb, par->initial_padding);
+        avio_wb32(pb, par->trailing_padding);
+        avio_wb32(pb, par->seek_preroll);
+
+        put_rational(pb, st->time_base);
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb64(pb, st->nb_frames);
+        avio_wb32(pb, st->disposition);
+        put_rational(pb, st->sample_aspect_ratio);
+        put_rational(pb, st->r_frame_rate);
+        put_rational(pb, st->avg_frame_rate);
+        avio_wb32(pb, st->codec_info_nb_frames);
+        avio_wb32(pb, st->nb_decoded_frames);
+
+        /* codec context fields used while demuxing */
+        put_rational(pb, avctx->time_base);
+        avio_wb32(pb, avctx->ticks_per_frame);
+        put_rational(pb, avctx->framerate);
+        avio_wb32(pb, avctx->properties);
+        avio_wb32(pb, avctx->coded_width);
+        avio_wb32(pb, avctx->coded_height);
+    }
+
+    return avio_close_dyn_buf(pb, buf);
+}
+
+/**
+ * Check the parameters of the cache entry against the streams created by
+ * the demuxer, and restore them if they match.
+ */
+static int read_params(AVFormatContext *s, GetByteContext *gb)
+{
+    char name[64];
+    unsigned len;
+    int i, ret;
+
+    len = bytestream2_get_be32(gb);
+    if (len >= sizeof(name) || bytestream2_get_buffer(gb, name, len) != len)
+        return AVERROR_INVALIDDATA;
+    name[len] = 0;
+    if (strcmp(name, s->iformat->name))
+        return AVERROR_INVALIDDATA;
+
+    /* check the streams before changing anything */
+    {
+        GetByteContext gb2 = *gb;
+
+        bytestream2_skip(&gb2, 8 + 8 + 8 + 4);
+        if (bytestream2_get_be32(&gb2) != s->nb_streams)
+            return AVERROR_INVALIDDATA;
+        for (i = 0; i < s->nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            int id, type, extradata_size;
+
+            id   = bytestream2_get_be32(&gb2);
+            type = bytestream2_get_be32(&gb2);
+            if (id != st->id || type != st->codecpar->codec_type)
+                return AVERROR_INVALIDDATA;
+            bytestream2_skip(&gb2, 8);
+            extradata_size = bytestream2_get_be32(&gb2);
+            if (extradata_size < 0 ||
+                bytestream2_get_bytes_left(&gb2) < extradata_size + STREAM_PARAMS_SIZE)
+                return AVERROR_INVALIDDATA;
+            bytestream2_skip(&gb2, extradata_size + STREAM_PARAMS_SIZE);
+        }
+    }
+
+    s->start_time                 = bytestream2_get_be64(gb);
+    s->duration                   = bytestream2_get_be64(gb);
+    s->bit_rate                   = bytestream2_get_be64(gb);
+    s->duration_estimation_method = bytestream2_get_be32(gb);
+    bytestream2_skip(gb, 4);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st            = s->streams[i];
+        AVCodecParameters *par  = st->codecpar;
+        AVCodecContext *avctx   = st->internal->avctx;
+
+        bytestream2_skip(gb, 8);
+        par->codec_id  = bytestream2_get_be32(gb);
+        par->codec_tag = bytestream2_get_be32(gb);
+        av_freep(&par->extradata);
+        par->extradata_size = bytestream2_get_be32(gb);
+        if (par->extradata_size) {
+            par->extradata = av_mallocz(par->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!par->extradata) {
+                par->extradata_size = 0;
+                return AVERROR(ENOMEM);
+            }
+            bytestream2_get_buffer(gb, par->extradata, par->extradata_size);
+        }
+        par->format                = bytestream2_get_be32(gb);
+        par->bit_rate              = bytestream2_get_be64(gb);
+        par->bits_per_coded_sample = bytestream2_get_be32(gb);
+        par->bits_per_raw_sample   = bytestream2_get_be32(gb);
+        par->profile               = bytestream2_get_be32(gb);
+        par->level                 = bytestream2_get_be32(gb);
+        par->width                 = bytestream2_get_be32(gb);
+        par->height                = bytestream2_get_be32(gb);
+        par->sample_aspect_ratio   = get_rational(gb);
+        par->field_order           = bytestream2_get_be32(gb);
+        par->color_range           = bytestream2_get_be32(gb);
+        par->color_primaries       = bytestream2_get_be32(gb);
+        par->color_trc             = bytestream2_get_be32(gb);
+        par->color_space           = bytestream2_get_be32(gb);
+        par->chroma_location       = bytestream2_get_be32(gb);
+        par->video_delay           = bytestream2_get_be32(gb);
+        par->channel_layout        = bytestream2_get_be64(gb);
+        par->channels              = bytestream2_get_be32(gb);
+        par->sample_rate           = bytestream2_get_be32(gb);
+        par->block_align           = bytestream2_get_be32(gb);
+        par->frame_size            = bytestream2_get_be32(gb);
+        par->initial_padding       = bytestream2_get_be32(gb);
+        par->trailing_padding      = bytestream2_get_be32(gb);
+        par->seek_preroll          = bytestream2_get_be32(gb);
+
+        st->time_base            = get_rational(gb);
+        st->start_time           = bytestream2_get_be64(gb);
+        st->duration             = bytestream2_get_be64(gb);
+        st->nb_frames            = bytestream2_get_be64(gb);
+        st->disposition          = bytestream2_get_be32(gb);
+        st->sample_aspect_ratio  = get_rational(gb);
+        st->r_frame_rate         = get_rational(gb);
+        st->avg_frame_rate       = get_rational(gb);
+        st->codec_info_nb_frames = bytestream2_get_be32(gb);
+        st->nb_decoded_frames    = bytestream2_get_be32(gb);
+        st->internal->orig_codec_id = par->codec_id;
+
+        ret = avcodec_parameters_to_context(avctx, par);
+        if (ret < 0)
+            return ret;
+        avctx->time_base       = get_rational(gb);
+        avctx->ticks_per_frame = bytestream2_get_be32(gb);
+        avctx->framerate       = get_rational(gb);
+        avctx->properties      = bytestream2_get_be32(gb);
+        avctx->coded_width     = bytestream2_get_be32(gb);
+        avctx->coded_height    = bytestream2_get_be32(gb);
+    }
+
+    return 0;
+}
+
+static int read_index(AVFormatContext *s, GetByteContext *gb)
+{
+    int nb_streams = bytestream2_get_be32(gb);
+    int i, j;
+
+    for (i = 0; i < nb_streams; i++) {
+        unsigned index = bytestream2_get_be32(gb);
+        int nb_entries = bytestream2_get_be32(gb);
+        AVStream *st;
+
+        if (index >= s->nb_streams || nb_entries < 0 ||
+            bytestream2_get_bytes_left(gb) / INDEX_ENTRY_SIZE < nb_entries)
+            return AVERROR_INVALIDDATA;
+        st = s->streams[index];
+
+        /* keep the index built from the header if it is as complete */
+        if (st->nb_index_entries >= nb_entries) {
+            bytestream2_skip(gb, INDEX_ENTRY_SIZE * nb_entries);
+            continue;
+        }
+        for (j = 0; j < nb_entries; j++) {
+            int64_t pos       = bytestream2_get_be64(gb);
+            int64_t timestamp = bytestream2_get_be64(gb);
+            int size          = bytestream2_get_be32(gb);
+            int distance      = bytestream2_get_be32(gb);
+            int flags         = bytestream2_get_byte(gb);
+
+            /* the index only speeds up seeking, ignore entries that
+             * cannot be added */
+            ff_add_index_entry(&st->index_entries, &st->nb_index_entries,
+                               &st->index_entries_allocated_size,
+                               pos, timestamp, size, distance, flags);
+        }
+    }
+
+    return 0;
+}
+
+static void write_index(AVFormatContext *s, AVIOContext *pb)
+{
+    int i, j, nb_streams = 0;
+
+    if (index_is_cached(s))
+        for (i = 0; i < s->nb_streams; i++)
+            nb_streams += !!s->streams[i]->nb_index_entries;
+
+    avio_wb32(pb, nb_streams);
+    for (i = 0; i < s->nb_streams && nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        if (!st->nb_index_entries)
+            continue;
+        avio_wb32(pb, i);
+        avio_wb32(pb, st->nb_index_entries);
+        for (j = 0; j < st->nb_index_entries; j++) {
+            const AVIndexEntry *ie = &st->index_entries[j];
+
+            avio_wb64(pb, ie->pos);
+            avio_wb64(pb, ie->timestamp);
+            avio_wb32(pb, ie->size);
+            avio_wb32(pb, ie->min_distance);
+            avio_w8(pb, ie->flags);
+        }
+    }
+}
+
+int ff_probe_cache_load(AVFormatContext *s)
+{
+    ProbeCacheKey key;
+    GetByteContext gb;
+    struct stat st;
+    uint8_t *buf;
+    size_t size;
+    char *path;
+    int ret, len, params_size;
+
+    if (get_key(s, &key) < 0)
+        return 0;
+    if (!(path = get_cache_path(s, &key)))
+        return AVERROR(ENOMEM);
+    ret = stat(path, &st) < 0 ? AVERROR(ENOENT) :
+          av_file_map(path, &buf, &size, 0, s);
+    av_free(path);
+    if (ret < 0)
+        return 0;
+
+    bytestream2_init(&gb, buf, FFMIN(size, INT_MAX));
+    ret = AVERROR_INVALIDDATA;
+    if (bytestream2_get_le32(&gb) != MKTAG('F','F','P','C') ||
+        bytestream2_get_be32(&gb) != PROBE_CACHE_VERSION)
+        goto fail;
+    len = bytestream2_get_be32(&gb);
+    if (len != strlen(key.path) || bytestream2_get_bytes_left(&gb) < len ||
+        memcmp(gb.buffer, key.path, len))
+        goto fail;
+    bytestream2_skip(&gb, len);
+    if (bytestream2_get_be64(&gb) != key.size ||
+        bytestream2_get_be64(&gb) != key.mtime ||
+        bytestream2_get_be64(&gb) != key.probesize ||
+        bytestream2_get_be64(&gb) != key.max_analyze_duration ||
+        (int)bytestream2_get_be32(&gb) != key.fps_probe_size)
+        goto fail;
+
+    params_size = bytestream2_get_be32(&gb);
+    if (params_size <= 0 || bytestream2_get_bytes_left(&gb) < params_size)
+        goto fail;
+    av_freep(&s->internal->probe_cache_params);
+    s->internal->probe_cache_params = av_memdup(gb.buffer, params_size);
+    if (!s->internal->probe_cache_params) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    s->internal->probe_cache_params_size = params_size;
+
+    {
+        GetByteContext params;
+
+        bytestream2_init(&params, gb.buffer, params_size);
+        if ((ret = read_params(s, &params)) < 0)
+            goto fail;
+    }
+    bytestream2_skip(&gb, params_size);
+    if ((ret = read_index(s, &gb)) < 0)
+        goto fail;
+    s->internal->probe_cache_index_entries = nb_cached_index_entries(s);
+
+    av_file_unmap(buf, size);
+    av_log(s, AV_LOG_VERBOSE, "Stream parameters loaded from the probe cache\n");
+    return 1;
+
+fail:
+    av_file_unmap(buf, size);
+    av_freep(&s->internal->probe_cache_params);
+    if (ret == AVERROR(ENOMEM))
+        return ret;
+    av_log(s, AV_LOG_VERBOSE, "No valid probe cache entry\n");
+    return 0;
+}
+
+int ff_probe_cache_save(AVFormatContext *s)
+{
+    ProbeCacheKey key;
+    AVIOContext *pb;
+    char *path, *tmp_path;
+    int ret;
+
+    if (get_key(s, &key) < 0)
+        return 0;
+
+    if (!s->internal->probe_cache_params) {
+        ret = write_params(s, &s->internal->probe_cache_params);
+        if (ret <= 0) {
+            av_freep(&s->internal->probe_cache_params);
+            return ret < 0 ? ret : AVERROR(ENOMEM);
+        }
+        s->internal->probe_cache_params_size = ret;
+    }
+
+    path     = get_cache_path(s, &key);
+    /* other processes or threads may write the same entry concurrently */
+    tmp_path = path ? av_asprintf("%s.%08x.tmp", path, av_get_random_seed()) : NULL;
+    if (!tmp_path) {
+        av_free(path);
+        return AVERROR(ENOMEM);
+    }
+
+    ret = avio_open2(&pb, tmp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write the probe cache entry %s\n", tmp_path);
+        goto end;
+    }
+    avio_wl32(pb, MKTAG('F','F','P','C'));
+    avio_wb32(pb, PROBE_CACHE_VERSION);
+    put_string(pb, key.path);
+    avio_wb64(pb, key.size);
+    avio_wb64(pb, key.mtime);
+    avio_wb64(pb, key.probesize);
+    avio_wb64(pb, key.max_analyze_duration);
+    avio_wb32(pb, key.fps_probe_size);
+    avio_wb32(pb, s->internal->probe_cache_params_size);
+    avio_write(pb, s->internal->probe_cache_params, s->internal->probe_cache_params_size);
+    write_index(s, pb);
+    avio_flush(pb);
+    ret = pb->error;
+    avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp_path, path, s);
+    if (ret < 0)
+        avpriv_io_delete(tmp_path);
+    s->internal->probe_cache_index_entries = nb_cached_index_entries(s);
+
+end:
+    av_free(tmp_path);
+    av_free(path);
+    return ret;
+}
+
+int ff_probe_cache_update(AVFormatContext *s)
+{
+    if (!s->internal->probe_cache_params ||
+        nb_cached_index_entries(s) <= s->internal->probe_cache_index_entries)
+        return 0;
+    return ff_probe_cache_save(s);
+}
@@ -1042,8 +1042,10 @@ static int rm_read_packet(AVFormatContext *s, AVPacket *pkt)
                                       &seq, flags, timestamp);
             if (res < -1)
                 return res;
-            if((flags&2) && (seq&0x7F) == 1)
+            if((flags&2) && (seq&0x7F) == 1) {
+                ff_reduce_index(s, st->index);
                 av_add_index_entry(st, pos, timestamp, 0, 0, AVINDEX_KEYFRAME);
+            }
             if (res)
                 continue;
         }
@@ -32,6 +32,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/timestamp.h"
@@ -472,6 +473,73 @@ int avformat_queue_attached_pictures(AVFormatContext *s)
     return 0;
 }
 
+typedef struct ProbeDecodeJob {
+    AVStream *st;
+    AVPacket pkt;
+} ProbeDecodeJob;
+
+typedef struct ProbeDecodeContext {
+    AVFormatContext *s;
+    AVSliceThread *thread;
+    int nb_threads;
+    ProbeDecodeJob *running;    ///< jobs being decoded by the threads
+    int nb_running;
+    ProbeDecodeJob *queued;     ///< jobs started once the running ones are done
+    int nb_queued;
+} ProbeDecodeContext;
+
+/**
+ * @return 1 if a packet of st is being decoded, 2 if it is queued, 0 otherwise
+ */
+static int probe_decode_pending(ProbeDecodeContext *pd, AVStream *st)
+{
+    int i;
+
+    for (i = 0; i < pd->nb_running; i++)
+        if (pd->running[i].st == st)
+            return 1;
+    for (i = 0; i < pd->nb_queued; i++)
+        if (pd->queued[i].st == st)
+            return 2;
+    return 0;
+}
+
+static void probe_decode_wait(ProbeDecodeContext *pd)
+{
+    if (pd->nb_running) {
+        avpriv_slicethread_wait(pd->thread);
+        pd->nb_running = 0;
+    }
+}
+
+static void probe_decode_start(ProbeDecodeContext *pd)
+{
+    probe_decode_wait(pd);
+    if (pd->nb_queued) {
+        FFSWAP(ProbeDecodeJob *, pd->running, pd->queued);
+        pd->nb_running = pd->nb_queued;
+        pd->nb_queued  = 0;
+        avpriv_slicethread_execute_async(pd->thread, pd->nb_running, 1);
+    }
+}
+
+/**
+ * Wait until the packets of st given to the probe decoding threads are
+ * decoded. Must be called before accessing the codec context of st while
+ * avformat_find_stream_info() runs.
+ */
+static void probe_decode_sync(AVFormatContext *s, AVStream *st)
+{
+    ProbeDecodeContext *pd = s->internal->probe_decode;
+    int pending;
+
+    if (!pd || !(pending = probe_decode_pending(pd, st)))
+        return;
+    if (pending == 2)
+        probe_decode_start(pd);
+    probe_decode_wait(pd);
+}
+
 static int update_stream_avctx(AVFormatContext *s)
 {
     int i, ret;
@@ -481,6 +549,8 @@ static int update_stream_avctx(AVFormatContext *s)
         if (!st->internal->need_context_update)
             continue;
 
+        probe_decode_sync(s, st);
+
         /* close parser, because it depends on the codec */
         if (st->parser && st->internal->avctx->codec_id != st->codecpar->codec_id) {
             av_parser_close(st->parser);
@@ -1522,8 +1592,10 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
             /* flush the parsers */
             for (i = 0; i < s->nb_streams; i++) {
                 st = s->streams[i];
-                if (st->parser && st->need_parsing)
+                if (st->parser && st->need_parsing) {
+                    probe_decode_sync(s, st);
                     parse_packet(s, NULL, st->index);
+                }
             }
             /* all remaining packets are now in parse_queue =>
              * really terminate parsing */
@@ -1531,6 +1603,7 @@ static int read_frame_internal(AVFormatContext *s, AVPacket *pkt)
         }
         ret = 0;
         st  = s->streams[cur_pkt.stream_index];
+        probe_decode_sync(s, st);
 
         /* update context if required */
         if (st->internal->need_context_update) {
@@ -1925,6 +1998,7 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
                        int size, int distance, int flags)
 {
     AVIndexEntry *entries, *ie;
+    unsigned int min_size_needed;
     int index;
 
     if ((unsigned) *nb_index_entries + 1 >= UINT_MAX / sizeof(AVIndexEntry))
@@ -1939,17 +2013,28 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
     if (is_relative(timestamp)) //FIXME this maintains previous behavior but we should shift by the correct offset once known
         timestamp -= RELATIVE_TS_BASE;
 
-    entries = av_fast_realloc(*index_entries,
-                              index_entries_allocated_size,
-                              (*nb_index_entries + 1) *
-                              sizeof(AVIndexEntry));
-    if (!entries)
-        return -1;
-
-    *index_entries = entries;
+    min_size_needed = (*nb_index_entries + 1) * sizeof(AVIndexEntry);
+    if (min_size_needed > *index_entries_allocated_size) {
+        /* Grow geometrically, streaming demuxers add an entry per keyframe
+         * for the whole duration of the input. */
+        unsigned int requested_size = *index_entries_allocated_size <= UINT_MAX / 2 ?
+            FFMAX(min_size_needed, 2 * *index_entries_allocated_size) :
+            min_size_needed;
+        entries = av_fast_realloc(*index_entries,
+                                  index_entries_allocated_size,
+                                  requested_size);
+        if (!entries)
+            return -1;
+        *index_entries = entries;
+    }
+    entries = *index_entries;
 
-    index = ff_index_search_timestamp(*index_entries, *nb_index_entries,
-                                      timestamp, AVSEEK_FLAG_ANY);
+    // Entries are usually added in order, skip the search in that case.
+    if (!*nb_index_entries || entries[*nb_index_entries - 1].timestamp < timestamp)
+        index = -1;
+    else
+        index = ff_index_search_timestamp(entries, *nb_index_entries,
+                                          timestamp, AVSEEK_FLAG_ANY);
 
     if (index < 0) {
         index = (*nb_index_entries)++;
@@ -2938,21 +3023,23 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
-/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
-static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
-                            AVDictionary **options)
+/* Whether try_decode_frame() still has to decode frames of st. */
+static int probe_frames_needed(AVStream *st)
 {
     AVCodecContext *avctx = st->internal->avctx;
-    const AVCodec *codec;
-    int got_picture = 1, ret = 0;
-    AVFrame *frame = av_frame_alloc();
-    AVSubtitle subtitle;
-    AVPacket pkt = *avpkt;
-    int do_skip_frame = 0;
-    enum AVDiscard skip_frame;
 
-    if (!frame)
-        return AVERROR(ENOMEM);
+    return !has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
+           (!st->codec_info_nb_frames &&
+            (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF));
+}
+
+/* Open the decoder used by try_decode_frame() if it is not open yet. */
+static int open_probe_decoder(AVFormatContext *s, AVStream *st,
+                              AVDictionary **options)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    const AVCodec *codec;
+    int ret = 0;
 
     if (!avcodec_is_open(avctx) &&
         st->info->found_decoder <= 0 &&
@@ -2963,8 +3050,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
 
         if (!codec) {
             st->info->found_decoder = -st->codecpar->codec_id;
-            ret                     = -1;
-            goto fail;
+            return -1;
         }
 
         /* Force thread count to 1 since the H.264 decoder will not extract
@@ -2977,16 +3063,30 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
             av_dict_free(&thread_opt);
         if (ret < 0) {
             st->info->found_decoder = -avctx->codec_id;
-            goto fail;
+            return ret;
         }
         st->info->found_decoder = 1;
     } else if (!st->info->found_decoder)
         st->info->found_decoder = 1;
 
-    if (st->info->found_decoder < 0) {
-        ret = -1;
-        goto fail;
-    }
+    if (st->info->found_decoder < 0)
+        return -1;
+    return 0;
+}
+
+/* Decode avpkt with the decoder opened by open_probe_decoder(). */
+static int decode_probe_frames(AVStream *st, AVPacket *avpkt)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+    int got_picture = 1, ret = 0;
+    AVFrame *frame = av_frame_alloc();
+    AVSubtitle subtitle;
+    AVPacket pkt = *avpkt;
+    int do_skip_frame = 0;
+    enum AVDiscard skip_frame;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
 
     if (avpriv_codec_get_cap_skip_frame_fill_param(avctx->codec)) {
         do_skip_frame = 1;
@@ -2995,10 +3095,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
     }
 
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
-           ret >= 0 &&
-           (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
-            (!st->codec_info_nb_frames &&
-             (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
+           ret >= 0 && probe_frames_needed(st)) {
         got_picture = 0;
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO ||
             avctx->codec_type == AVMEDIA_TYPE_AUDIO) {
@@ -3028,7 +3125,6 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
     if (!pkt.data && !got_picture)
         ret = -1;
 
-fail:
     if (do_skip_frame) {
         avctx->skip_frame = skip_frame;
     }
@@ -3037,6 +3133,114 @@ fail:
     return ret;
 }
 
+/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
+                            AVDictionary **options)
+{
+    int ret = open_probe_decoder(s, st, options);
+
+    if (ret < 0)
+        return ret;
+    return decode_probe_frames(st, avpkt);
+}
+
+static void probe_decode_worker(void *priv, int jobnr, int threadnr,
+                                int nb_jobs, int nb_threads)
+{
+    ProbeDecodeContext *pd = priv;
+    ProbeDecodeJob *job    = &pd->running[jobnr];
+
+    decode_probe_frames(job->st, &job->pkt);
+    job->st->codec_info_nb_frames++;
+    av_packet_unref(&job->pkt);
+}
+
+static void probe_decode_main(void *priv)
+{
+}
+
+static int probe_decode_init(AVFormatContext *s)
+{
+    ProbeDecodeContext *pd;
+    int ret;
+
+    if (s->probe_threads == 1)
+        return 0;
+
+    pd = av_mallocz(sizeof(*pd));
+    if (!pd)
+        return AVERROR(ENOMEM);
+
+    ret = avpriv_slicethread_create(&pd->thread, pd, probe_decode_worker,
+                                    probe_decode_main, s->probe_threads);
+    if (ret < 0) {
+        /* no threading support, decode everything in the calling thread */
+        av_free(pd);
+        return ret == AVERROR(ENOMEM) ? ret : 0;
+    }
+    pd->s          = s;
+    pd->nb_threads = ret;
+    pd->running    = av_calloc(pd->nb_threads, sizeof(*pd->running));
+    pd->queued     = av_calloc(pd->nb_threads, sizeof(*pd->queued));
+    s->internal->probe_decode = pd;
+    if (!pd->running || !pd->queued)
+        return AVERROR(ENOMEM);
+
+    av_log(s, AV_LOG_DEBUG, "Decoding streams with %d threads\n", pd->nb_threads);
+    return 0;
+}
+
+static void probe_decode_free(AVFormatContext *s)
+{
+    ProbeDecodeContext *pd = s->internal->probe_decode;
+    int i;
+
+    if (!pd)
+        return;
+
+    probe_decode_wait(pd);
+    for (i = 0; i < pd->nb_queued; i++)
+        av_packet_unref(&pd->queued[i].pkt);
+    avpriv_slicethread_free(&pd->thread);
+    av_freep(&pd->running);
+    av_freep(&pd->queued);
+    av_freep(&s->internal->probe_decode);
+}
+
+/**
+ * Same as try_decode_frame() followed by incrementing st->codec_info_nb_frames,
+ * except that the decoder is only opened here and the packet is decoded by
+ * one of the probe decoding threads.
+ */
+static int probe_decode_submit(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                               AVDictionary **options)
+{
+    ProbeDecodeContext *pd = s->internal->probe_decode;
+    ProbeDecodeJob *job;
+    int ret;
+
+    probe_decode_sync(s, st);
+    if (open_probe_decoder(s, st, options) < 0 ||
+        !avcodec_is_open(st->internal->avctx) || !probe_frames_needed(st)) {
+        st->codec_info_nb_frames++;
+        return 0;
+    }
+
+    if (pd->nb_queued == pd->nb_threads)
+        probe_decode_start(pd);
+    job = &pd->queued[pd->nb_queued];
+    if ((ret = av_packet_ref(&job->pkt, pkt)) < 0)
+        return ret;
+    job->st = st;
+    pd->nb_queued++;
+
+    /* Start right away if the threads are idle, otherwise the queued jobs
+     * are started together when the running ones are waited for. */
+    if (!pd->nb_running)
+        probe_decode_start(pd);
+    return 0;
+}
+
 unsigned int ff_codec_get_tag(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3492,6 +3696,47 @@ static int extract_extradata(AVStream *st, AVPacket *pkt)
     return 0;
 }
 
+/* Whether more packets of st must be analyzed by avformat_find_stream_info(). */
+static int stream_info_needed(AVFormatContext *ic, AVStream *st)
+{
+    int fps_analyze_framecount = 20;
+
+    if (!has_codec_parameters(st, NULL))
+        return 1;
+    /* If the timebase is coarse (like the usual millisecond precision
+     * of mkv), we need to analyze more frames to reliably arrive at
+     * the correct fps. */
+    if (av_q2d(st->time_base) > 0.0005)
+        fps_analyze_framecount *= 2;
+    if (!tb_unreliable(st->internal->avctx))
+        fps_analyze_framecount = 0;
+    if (ic->fps_probe_size >= 0)
+        fps_analyze_framecount = ic->fps_probe_size;
+    if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
+        fps_analyze_framecount = 0;
+    /* variable fps and no guess at the real fps */
+    if (!(st->r_frame_rate.num && st->avg_frame_rate.num) &&
+        st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        int count = (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ?
+            st->info->codec_info_duration_fields/2 :
+            st->info->duration_count;
+        if (count < fps_analyze_framecount)
+            return 1;
+    }
+    if (!st->internal->avctx->extradata &&
+        (!st->internal->extract_extradata.inited ||
+         st->internal->extract_extradata.bsf) &&
+        extract_extradata_check(st))
+        return 1;
+    if (st->first_dts == AV_NOPTS_VALUE &&
+        !(ic->iformat->flags & AVFMT_NOTIMESTAMPS) &&
+        st->codec_info_nb_frames < ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) ? 1 : ic->max_ts_probe) &&
+        (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
+         st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO))
+        return 1;
+    return 0;
+}
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count = 0, ret = 0, j;
@@ -3512,6 +3757,16 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 
     flush_codecs = probesize > 0;
 
+    if (ic->probe_cache) {
+        ret = ff_probe_cache_load(ic);
+        if (ret < 0)
+            goto find_stream_info_err;
+        if (ret > 0) {
+            ret = 0;
+            goto update_stream_params;
+        }
+    }
+
     av_opt_set(ic, "skip_clear", "1", AV_OPT_SEARCH_CHILDREN);
 
     max_stream_analyze_duration = max_analyze_duration;
@@ -3615,6 +3870,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+    ret = probe_decode_init(ic);
+    if (ret < 0)
+        goto find_stream_info_err;
+
     read_size = 0;
     for (;;) {
         int analyzed_all_streams;
@@ -3624,44 +3883,23 @@ FF_ENABLE_DEPRECATION_WARNINGS
             break;
         }
 
-        /* check if one codec still needs to be handled */
+        /* check if one codec still needs to be handled, looking first at
+         * the streams which are not being decoded by other threads */
         for (i = 0; i < ic->nb_streams; i++) {
-            int fps_analyze_framecount = 20;
-
             st = ic->streams[i];
-            if (!has_codec_parameters(st, NULL))
+            if (ic->internal->probe_decode &&
+                probe_decode_pending(ic->internal->probe_decode, st))
+                continue;
+            if (stream_info_needed(ic, st))
                 break;
-            /* If the timebase is coarse (like the usual millisecond precision
-             * of mkv), we need to analyze more frames to reliably arrive at
-             * the correct fps. */
-            if (av_q2d(st->time_base) > 0.0005)
-                fps_analyze_framecount *= 2;
-            if (!tb_unreliable(st->internal->avctx))
-                fps_analyze_framecount = 0;
-            if (ic->fps_probe_size >= 0)
-                fps_analyze_framecount = ic->fps_probe_size;
-            if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
-                fps_analyze_framecount = 0;
-            /* variable fps and no guess at the real fps */
-            if (!(st->r_frame_rate.num && st->avg_frame_rate.num) &&
-                st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                int count = (ic->iformat->flags & AVFMT_NOTIMESTAMPS) ?
-                    st->info->codec_info_duration_fields/2 :
-                    st->info->duration_count;
-                if (count < fps_analyze_framecount)
+        }
+        if (i == ic->nb_streams && ic->internal->probe_decode) {
+            for (i = 0; i < ic->nb_streams; i++) {
+                st = ic->streams[i];
+                probe_decode_sync(ic, st);
+                if (stream_info_needed(ic, st))
                     break;
             }
-            if (!st->internal->avctx->extradata &&
-                (!st->internal->extract_extradata.inited ||
-                 st->internal->extract_extradata.bsf) &&
-                extract_extradata_check(st))
-                break;
-            if (st->first_dts == AV_NOPTS_VALUE &&
-                !(ic->iformat->flags & AVFMT_NOTIMESTAMPS) &&
-                st->codec_info_nb_frames < ((st->disposition & AV_DISPOSITION_ATTACHED_PIC) ? 1 : ic->max_ts_probe) &&
-                (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO ||
-                 st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO))
-                break;
         }
         analyzed_all_streams = 0;
         if (!missing_streams || !*missing_streams)
@@ -3819,16 +4057,28 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (ic->internal->probe_decode) {
+            ret = probe_decode_submit(ic, st, pkt,
+                                      (options && i < orig_nb_streams) ? &options[i] : NULL);
+            if (ret < 0)
+                goto find_stream_info_err;
+        } else {
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL);
+            st->codec_info_nb_frames++;
+        }
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
 
-        st->codec_info_nb_frames++;
         count++;
     }
 
+    if (ic->internal->probe_decode) {
+        probe_decode_start(ic->internal->probe_decode);
+        probe_decode_free(ic);
+    }
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -4013,6 +4263,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
+update_stream_params:
     compute_chapters_end(ic);
 
     /* update the stream parameters from the internal codec contexts */
@@ -4071,7 +4322,18 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    if (ic->probe_cache && !ic->internal->probe_cache_params) {
+        /* do not cache incomplete parameters, which would be used even when
+         * a later analysis could find them */
+        for (i = 0; i < ic->nb_streams; i++)
+            if (!has_codec_parameters(ic->streams[i], NULL))
+                break;
+        if (i == ic->nb_streams)
+            ff_probe_cache_save(ic);
+    }
+
 find_stream_info_err:
+    probe_decode_free(ic);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->info)
@@ -4332,6 +4594,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_dict_free(&s->internal->id3v2_meta);
+    av_freep(&s->internal->probe_cache_params);
     av_freep(&s->streams);
     av_freep(&s->internal);
     flush_packet_queue(s);
@@ -4355,6 +4618,9 @@ void avformat_close_input(AVFormatContext **ps)
 
     flush_packet_queue(s);
 
+    if (s->iformat && s->probe_cache)
+        ff_probe_cache_update(s);
+
     if (s->iformat)
         if (s->iformat->read_close)
             s->iformat->read_close(s);
@@ -44,6 +44,9 @@ struct AVSliceThread {
     pthread_cond_t  done_cond;
     int             done;
     int             finished;
+    int             in_flight;      ///< jobs started by execute_async() and not waited for
+    int             run_by_caller;  ///< the calling thread takes part in running the jobs
+    int             reserve_jobs;   ///< each thread starts with the job of its number
 
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
@@ -57,9 +60,15 @@ static int run_jobs(AVSliceThread *ctx)
     unsigned first_job    = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
     unsigned current_job  = first_job;
 
-    do {
+    /* after execute_async(), no job is reserved for a thread, so that the
+     * workers do not leave one behind for a caller busy with something else */
+    if (!ctx->reserve_jobs)
+        current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel);
+
+    while (current_job < nb_jobs) {
         ctx->worker_func(ctx->priv, current_job, first_job, nb_jobs, nb_active_threads);
-    } while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs);
+        current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel);
+    }
 
     return current_job == nb_jobs + nb_active_threads - 1;
 }
@@ -165,15 +174,18 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return nb_threads;
 }
 
-void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
+static void start_jobs(AVSliceThread *ctx, int nb_jobs, int execute_main, int reserve_jobs)
 {
-    int nb_workers, i, is_last = 0;
+    int nb_workers, i;
 
     av_assert0(nb_jobs > 0);
+    av_assert0(!ctx->in_flight);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    ctx->reserve_jobs      = reserve_jobs;
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
-    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
+    atomic_store_explicit(&ctx->current_job, reserve_jobs ? ctx->nb_active_threads : 0,
+                          memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
     if (!ctx->main_func || !execute_main)
         nb_workers--;
@@ -186,9 +198,25 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
         pthread_mutex_unlock(&w->mutex);
     }
 
-    if (ctx->main_func && execute_main)
+    ctx->in_flight     = 1;
+    ctx->run_by_caller = !(ctx->main_func && execute_main);
+    if (!ctx->run_by_caller)
         ctx->main_func(ctx->priv);
-    else
+}
+
+void avpriv_slicethread_execute_async(AVSliceThread *ctx, int nb_jobs, int execute_main)
+{
+    start_jobs(ctx, nb_jobs, execute_main, 0);
+}
+
+void avpriv_slicethread_wait(AVSliceThread *ctx)
+{
+    int is_last = 0;
+
+    if (!ctx->in_flight)
+        return;
+
+    if (ctx->run_by_caller)
         is_last = run_jobs(ctx);
 
     if (!is_last) {
@@ -198,6 +226,13 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
         ctx->done = 0;
         pthread_mutex_unlock(&ctx->done_mutex);
     }
+    ctx->in_flight = 0;
+}
+
+void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
+{
+    start_jobs(ctx, nb_jobs, execute_main, 1);
+    avpriv_slicethread_wait(ctx);
 }
 
 void avpriv_slicethread_free(AVSliceThread **pctx)
@@ -209,6 +244,7 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    avpriv_slicethread_wait(ctx);
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -251,6 +287,16 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     av_assert0(0);
 }
 
+void avpriv_slicethread_execute_async(AVSliceThread *ctx, int nb_jobs, int execute_main)
+{
+    av_assert0(0);
+}
+
+void avpriv_slicethread_wait(AVSliceThread *ctx)
+{
+    av_assert0(0);
+}
+
 void avpriv_slicethread_free(AVSliceThread **pctx)
 {
     av_assert0(!pctx || !*pctx);
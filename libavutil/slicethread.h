@@ -43,6 +43,28 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
  */
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main);
 
+/**
+ * Start slice threading without waiting for the jobs to complete.
+ * The worker threads start processing the jobs immediately, while the caller
+ * is free to do other work before calling avpriv_slicethread_wait().
+ * When main_func is NULL, the calling thread counts as one of the threads and
+ * joins the workers from avpriv_slicethread_wait(), running the jobs they have
+ * not started yet. No job waits for it in the meantime.
+ * @param ctx slice threading context
+ * @param nb_jobs number of jobs, must be > 0
+ * @param execute_main also execute main_func, before returning
+ */
+void avpriv_slicethread_execute_async(AVSliceThread *ctx, int nb_jobs, int execute_main);
+
+/**
+ * Wait for the jobs started by avpriv_slicethread_execute_async() to complete,
+ * helping with the jobs which are not started yet. Must be called before
+ * the next execute call on the same context. Does nothing if no jobs are
+ * in flight.
+ * @param ctx slice threading context
+ */
+void avpriv_slicethread_wait(AVSliceThread *ctx);
+
 /**
  * Destroy slice threading context.
  * @param pctx pointer to context
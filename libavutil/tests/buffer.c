@@ -0,0 +1,165 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * This test program checks that AVBufferPool hands out and takes back
+ * buffers correctly when used from several threads.
+ * Run with "-b [max_threads]" to benchmark av_buffer_pool_get() and
+ * av_buffer_unref() of pooled buffers instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define MAX_THREADS   32
+#define BUFFER_SIZE   4096
+#define NB_HELD       3
+
+typedef struct ThreadContext {
+    AVBufferPool *pool;
+    int id;
+    int iterations;
+    int errors;
+} ThreadContext;
+
+static void *test_thread(void *arg)
+{
+    ThreadContext *t = arg;
+    AVBufferRef *held[NB_HELD] = { NULL };
+    int i, j;
+
+    for (i = 0; i < t->iterations; i++) {
+        for (j = 0; j <= i % NB_HELD; j++) {
+            held[j] = av_buffer_pool_get(t->pool);
+            if (!held[j] || !av_buffer_is_writable(held[j])) {
+                t->errors++;
+                continue;
+            }
+            memset(held[j]->data, t->id, BUFFER_SIZE);
+        }
+        for (j = 0; j <= i % NB_HELD; j++) {
+            if (held[j] && (held[j]->data[0]               != t->id ||
+                            held[j]->data[BUFFER_SIZE - 1] != t->id))
+                t->errors++;
+            av_buffer_unref(&held[j]);
+        }
+    }
+
+    return NULL;
+}
+
+static int run_threads(AVBufferPool *pool, int nb_threads, int iterations)
+{
+    ThreadContext ctx[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    int i, ret, errors = 0;
+
+    for (i = 0; i < nb_threads; i++) {
+        ctx[i].pool       = pool;
+        ctx[i].id         = i + 1;
+        ctx[i].iterations = iterations;
+        ctx[i].errors     = 0;
+        if ((ret = pthread_create(&threads[i], NULL, test_thread, &ctx[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            exit(1);
+        }
+    }
+    for (i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i], NULL);
+        errors += ctx[i].errors;
+    }
+
+    return errors;
+}
+
+static void bench(int max_threads)
+{
+    const int iterations = 200000;
+    int nb_threads;
+
+    for (nb_threads = 1; nb_threads <= max_threads; nb_threads *= 2) {
+        AVBufferPool *pool = av_buffer_pool_init(BUFFER_SIZE, NULL);
+        int64_t t;
+
+        if (!pool)
+            exit(1);
+        t = av_gettime_relative();
+        run_threads(pool, nb_threads, iterations);
+        t = av_gettime_relative() - t;
+        av_buffer_pool_uninit(&pool);
+
+        /* each iteration gets and releases 2 buffers on average */
+        printf("pool_get+unref %2d threads: %6.1f ns/buffer\n", nb_threads,
+               t * 1000.0 / (2.0 * iterations * nb_threads));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    AVBufferPool *pool;
+    AVBufferRef *buf;
+    uint8_t *data;
+    int errors;
+
+    if (argc > 1 && !strcmp(argv[1], "-b")) {
+        bench(argc > 2 ? av_clip(atoi(argv[2]), 1, MAX_THREADS) : 8);
+        return 0;
+    }
+
+    pool = av_buffer_pool_init(BUFFER_SIZE, NULL);
+    if (!pool)
+        return 1;
+
+    /* a released buffer must be handed out again */
+    buf = av_buffer_pool_get(pool);
+    if (!buf)
+        return 1;
+    data = buf->data;
+    av_buffer_unref(&buf);
+    buf = av_buffer_pool_get(pool);
+    if (!buf)
+        return 1;
+    if (buf->data != data || buf->size != BUFFER_SIZE ||
+        av_buffer_get_ref_count(buf) != 1) {
+        fprintf(stderr, "pooled buffer not reused\n");
+        return 2;
+    }
+    av_buffer_unref(&buf);
+
+    errors = run_threads(pool, 4, 10000);
+    if (errors) {
+        fprintf(stderr, "%d errors in threaded pool use\n", errors);
+        return 3;
+    }
+
+    /* the pool must stay alive until its last buffer is released */
+    buf = av_buffer_pool_get(pool);
+    av_buffer_pool_uninit(&pool);
+    if (!buf)
+        return 1;
+    memset(buf->data, 0, BUFFER_SIZE);
+    av_buffer_unref(&buf);
+
+    return 0;
+}
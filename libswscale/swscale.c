@@ -228,14 +228,22 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
-static int swscale(SwsContext *c, const uint8_t *src[],
-                   int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+/**
+ * Scale the given source slice.
+ * If dstSliceH is not 0, only the output lines dstSliceY to
+ * dstSliceY + dstSliceH - 1 are produced, starting from an empty line
+ * buffer; the source slice must then contain the whole picture.
+ */
+static int swscale_lines(SwsContext *c, const uint8_t *src[],
+                         int srcStride[], int srcSliceY,
+                         int srcSliceH, uint8_t *dst[], int dstStride[],
+                         int dstSliceY, int dstSliceH)
 {
     /* load a few things into local vars to make the code more readable?
      * and faster */
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int dstEnd                 = dstSliceH ? dstSliceY + dstSliceH : dstH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -341,6 +349,8 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
+    if (dstSliceH)
+        dstY = dstSliceY;
 
     if (!should_dither) {
         c->chrDither8 = c->lumDither8 = sws_pb_64;
@@ -369,7 +379,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -531,6 +541,41 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale(SwsContext *c, const uint8_t *src[],
+                   int srcStride[], int srcSliceY,
+                   int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return swscale_lines(c, src, srcStride, srcSliceY, srcSliceH,
+                         dst, dstStride, 0, 0);
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext *c      = parent->slice_ctx[jobnr];
+    const int align    = 1 << parent->chrDstVSubSample;
+    const int nb_lines = parent->dstH / align;
+    const int dstY     = (int64_t)nb_lines *  jobnr      / nb_jobs * align;
+    const int dstEnd   = jobnr == nb_jobs - 1 ? parent->dstH :
+                         (int64_t)nb_lines * (jobnr + 1) / nb_jobs * align;
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4], dstStride[4];
+
+    if (dstEnd <= dstY)
+        return;
+
+    /* swscale_lines() modifies the pointers and strides */
+    memcpy(src,       parent->frame_src,       sizeof(src));
+    memcpy(srcStride, parent->frame_srcStride, sizeof(srcStride));
+    memcpy(dst,       parent->frame_dst,       sizeof(dst));
+    memcpy(dstStride, parent->frame_dstStride, sizeof(dstStride));
+
+    swscale_lines(c, src, srcStride, 0, parent->srcH,
+                  dst, dstStride, dstY, dstEnd - dstY);
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -634,6 +679,49 @@ static int check_image_pointers(const uint8_t * const data[4], enum AVPixelForma
     return 1;
 }
 
+/**
+ * The SIMD output functions write whole vectors of up to 16 pixels, thus
+ * may write past the end of a line. This is harmless when the lines are
+ * written from top to bottom, but would corrupt the first line of the
+ * next slice when the slices are scaled in parallel, unless it lands in
+ * the line padding.
+ */
+static int dst_lines_independent(const SwsContext *c, const int dstStride[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->dstFormat);
+    int padded_w = FFALIGN(c->dstW, 16 << desc->log2_chroma_w);
+    int i;
+
+    for (i = 0; i < av_pix_fmt_count_planes(c->dstFormat); i++)
+        if (FFABS(dstStride[i]) < av_image_get_linesize(c->dstFormat, padded_w, i))
+            return 0;
+
+    return 1;
+}
+
+static int swscale_threaded(SwsContext *c, const uint8_t *src[],
+                            int srcStride[], uint8_t *dst[], int dstStride[])
+{
+    int i;
+
+    if (usePal(c->srcFormat)) {
+        for (i = 0; i < c->nb_slice_ctx; i++) {
+            memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+            memcpy(c->slice_ctx[i]->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+        }
+    }
+
+    memcpy(c->frame_src,       src,       sizeof(c->frame_src));
+    memcpy(c->frame_srcStride, srcStride, sizeof(c->frame_srcStride));
+    memcpy(c->frame_dst,       dst,       sizeof(c->frame_dst));
+    memcpy(c->frame_dstStride, dstStride, sizeof(c->frame_dstStride));
+
+    avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx, 0);
+
+    c->dstY = c->dstH;
+    return c->dstH;
+}
+
 static void xyz12Torgb48(struct SwsContext *c, uint16_t *dst,
                          const uint16_t *src, int stride, int h)
 {
@@ -977,7 +1065,11 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (c->slicethread && srcSliceY_internal == 0 && srcSliceH == c->srcH &&
+        dst_lines_independent(c, dstStride2))
+        ret = swscale_threaded(c, src2, srcStride2, dst2, dstStride2);
+    else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
@@ -31,6 +31,7 @@
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/ppc/util_altivec.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
@@ -321,6 +322,19 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* The slice_* fields allow splitting the output lines of a frame
+     * between several contexts, which are run in parallel. Each slice
+     * context has its own line buffers and filter state.
+     */
+    int nb_threads;
+    int nb_slice_ctx;
+    struct SwsContext **slice_ctx;
+    AVSliceThread *slicethread;
+    const uint8_t *frame_src[4];
+    int frame_srcStride[4];
+    uint8_t *frame_dst[4];
+    int frame_dstStride[4];
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -830,6 +844,13 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Slice threading worker, scales the jobnr-th range of output lines of
+ * the frame stored in the frame_* fields of the parent context priv.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
@@ -843,6 +843,88 @@ static void fill_xyztables(struct SwsContext *c)
     }
 }
 
+static void free_slice_contexts(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+}
+
+/* The slice contexts are allocated before c is initialized, as the
+ * initialization modifies some of the user supplied parameters. */
+static av_cold int alloc_slice_contexts(SwsContext *c)
+{
+    int i, ret;
+    int nb_threads = c->nb_threads ? c->nb_threads : av_cpu_count();
+
+    free_slice_contexts(c);
+    if (nb_threads <= 1)
+        return 0;
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads; i++) {
+        c->slice_ctx[i] = sws_alloc_context();
+        if (!c->slice_ctx[i])
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+        if ((ret = av_opt_copy(c->slice_ctx[i], c)) < 0)
+            return ret;
+        c->slice_ctx[i]->nb_threads = 1;
+    }
+
+    return 0;
+}
+
+static av_cold int init_slice_contexts(SwsContext *c, SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter)
+{
+    int i, ret;
+    int nb_slices = FFMIN(c->nb_slice_ctx,
+                          c->dstH / FFMAX(16, 1 << c->chrDstVSubSample));
+
+    /* error diffusion carries its state from one line to the next */
+    if (nb_slices <= 1 || c->dither == SWS_DITHER_ED) {
+        free_slice_contexts(c);
+        return 0;
+    }
+
+    for (i = nb_slices; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    c->nb_slice_ctx = nb_slices;
+
+    for (i = 0; i < nb_slices; i++) {
+        SwsContext *slice = c->slice_ctx[i];
+        if ((ret = sws_init_context(slice, srcFilter, dstFilter)) < 0)
+            return ret;
+        ret = sws_setColorspaceDetails(slice, c->srcColorspaceTable, c->srcRange,
+                                       c->dstColorspaceTable, c->dstRange,
+                                       c->brightness, c->contrast, c->saturation);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                    NULL, nb_slices);
+    if (ret == AVERROR(ENOSYS)) {
+        free_slice_contexts(c);
+        return 0;
+    }
+    if (ret < 0)
+        return ret;
+
+    if (c->flags & SWS_PRINT_INFO)
+        av_log(c, AV_LOG_INFO, "using %d slice threads\n", nb_slices);
+
+    return 0;
+}
+
 int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
                              int srcRange, const int table[4], int dstRange,
                              int brightness, int contrast, int saturation)
@@ -850,6 +932,7 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i;
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -889,6 +972,23 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
     c->dstFormatBpp = av_get_bits_per_pixel(desc_dst);
     c->srcFormatBpp = av_get_bits_per_pixel(desc_src);
 
+    if (c->slicethread) {
+        if ((isYUV(c->dstFormat) || isGray(c->dstFormat)) &&
+            (isYUV(c->srcFormat) || isGray(c->srcFormat)) &&
+            memcmp(c->dstColorspaceTable, c->srcColorspaceTable, sizeof(int) * 4)) {
+            /* the cascaded contexts set up below are used instead */
+            free_slice_contexts(c);
+        } else {
+            for (i = 0; i < c->nb_slice_ctx; i++) {
+                int ret = sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange,
+                                                   table, dstRange, brightness,
+                                                   contrast, saturation);
+                if (ret < 0)
+                    return ret;
+            }
+        }
+    }
+
     if (c->cascaded_context[c->cascaded_mainindex])
         return sws_setColorspaceDetails(c->cascaded_context[c->cascaded_mainindex],inv_table, srcRange,table, dstRange, brightness,  contrast, saturation);
 
@@ -1172,6 +1272,12 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     if (!rgb15to16)
         ff_sws_rgb2rgb_init();
 
+    if (c->nb_threads != 1) {
+        ret = alloc_slice_contexts(c);
+        if (ret < 0)
+            return ret;
+    }
+
     unscaled = (srcW == dstW && srcH == dstH);
 
     c->srcRange |= handle_jpeg(&c->srcFormat);
@@ -1794,7 +1900,9 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     }
 
     c->swscale = ff_getSwsFunc(c);
-    return ff_init_filters(c);
+    if ((ret = ff_init_filters(c)) < 0)
+        return ret;
+    return init_slice_contexts(c, srcFilter, dstFilter);
 fail: // FIXME replace things by appropriate error codes
     if (ret == RETCODE_USE_CASCADE)  {
         int tmpW = sqrt(srcW * (int64_t)dstW);
@@ -2318,6 +2426,8 @@ void sws_freeContext(SwsContext *c)
     av_freep(&c->yuvTable);
     av_freep(&c->formatConvBuffer);
 
+    free_slice_contexts(c);
+
     sws_freeContext(c->cascaded_context[0]);
     sws_freeContext(c->cascaded_context[1]);
     sws_freeContext(c->cascaded_context[2]);
@@ -0,0 +1,270 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Frame threaded decoding test.
+ * Encodes a short MPEG-4 stream with B-frames, then sends the first n packets
+ * to a frame threaded decoder with the send/receive API, flushes it and checks
+ * that every frame comes out, in the same order and with the same content as
+ * with a single thread.
+ */
+
+#include <string.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavutil/adler32.h"
+#include "libavutil/common.h"
+#include "libavutil/imgutils.h"
+
+#define NUMBER_OF_FRAMES 16
+#define MAX_THREADS 5
+#define WIDTH 64
+#define HEIGHT 48
+
+/* generate i-th frame of test video */
+static void generate_raw_frame(AVFrame *frame, int i)
+{
+    int x, y;
+
+    for (y = 0; y < HEIGHT; y++)
+        for (x = 0; x < WIDTH; x++)
+            frame->data[0][y * frame->linesize[0] + x] = x * 3 + y * 2 + i * 5;
+    for (y = 0; y < HEIGHT / 2; y++) {
+        for (x = 0; x < WIDTH / 2; x++) {
+            frame->data[1][y * frame->linesize[1] + x] = 128 + y + i * 2;
+            frame->data[2][y * frame->linesize[2] + x] =  64 + x + i * 3;
+        }
+    }
+}
+
+static int encode_stream(AVPacket *pkts, int *nb_pkts)
+{
+    AVCodec *enc = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    AVCodecContext *ctx = NULL;
+    AVFrame *frame = NULL;
+    int i, ret;
+
+    *nb_pkts = 0;
+
+    if (!enc) {
+        av_log(NULL, AV_LOG_ERROR, "Can't find encoder\n");
+        return AVERROR_ENCODER_NOT_FOUND;
+    }
+
+    ctx = avcodec_alloc_context3(enc);
+    frame = av_frame_alloc();
+    if (!ctx || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ctx->width        = WIDTH;
+    ctx->height       = HEIGHT;
+    ctx->pix_fmt      = AV_PIX_FMT_YUV420P;
+    ctx->time_base    = (AVRational){ 1, 25 };
+    ctx->max_b_frames = 2;
+    ctx->gop_size     = 12;
+    ctx->flags       |= AV_CODEC_FLAG_QSCALE;
+    ctx->global_quality = FF_QP2LAMBDA * 5;
+
+    ret = avcodec_open2(ctx, enc, NULL);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Can't open encoder\n");
+        goto end;
+    }
+
+    frame->format = ctx->pix_fmt;
+    frame->width  = ctx->width;
+    frame->height = ctx->height;
+    ret = av_frame_get_buffer(frame, 32);
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i <= NUMBER_OF_FRAMES; i++) {
+        if (i < NUMBER_OF_FRAMES) {
+            ret = av_frame_make_writable(frame);
+            if (ret < 0)
+                goto end;
+            generate_raw_frame(frame, i);
+            frame->pts = i;
+        }
+        ret = avcodec_send_frame(ctx, i < NUMBER_OF_FRAMES ? frame : NULL);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error sending a frame to the encoder\n");
+            goto end;
+        }
+        while (*nb_pkts < NUMBER_OF_FRAMES &&
+               (ret = avcodec_receive_packet(ctx, &pkts[*nb_pkts])) >= 0)
+            (*nb_pkts)++;
+        if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+            av_log(ctx, AV_LOG_ERROR, "Error receiving a packet from the encoder\n");
+            goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+static int receive_frames(AVCodecContext *ctx, AVFrame *frame,
+                          uint32_t *crcs, int *nb_frames)
+{
+    int ret, i;
+
+    while ((ret = avcodec_receive_frame(ctx, frame)) >= 0) {
+        uint32_t crc = 0;
+
+        if (*nb_frames >= NUMBER_OF_FRAMES) {
+            av_log(ctx, AV_LOG_ERROR, "Too many frames\n");
+            av_frame_unref(frame);
+            return AVERROR_BUG;
+        }
+        for (i = 0; i < 3; i++) {
+            int w = i ? WIDTH  / 2 : WIDTH;
+            int h = i ? HEIGHT / 2 : HEIGHT;
+            int y;
+
+            for (y = 0; y < h; y++)
+                crc = av_adler32_update(crc, frame->data[i] + y * frame->linesize[i], w);
+        }
+        crcs[(*nb_frames)++] = crc;
+        av_frame_unref(frame);
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+/* decode the first nb_pkts packets and flush the decoder */
+static int decode_packets(AVPacket *pkts, int nb_pkts, int threads,
+                          uint32_t *crcs, int *nb_frames)
+{
+    AVCodec *dec = avcodec_find_decoder(AV_CODEC_ID_MPEG4);
+    AVCodecContext *ctx = NULL;
+    AVFrame *frame = NULL;
+    int i, ret;
+
+    *nb_frames = 0;
+
+    if (!dec) {
+        av_log(NULL, AV_LOG_ERROR, "Can't find decoder\n");
+        return AVERROR_DECODER_NOT_FOUND;
+    }
+
+    ctx = avcodec_alloc_context3(dec);
+    frame = av_frame_alloc();
+    if (!ctx || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ctx->thread_count = threads;
+    ctx->thread_type  = FF_THREAD_FRAME;
+
+    ret = avcodec_open2(ctx, dec, NULL);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Can't open decoder\n");
+        goto end;
+    }
+
+    for (i = 0; i < nb_pkts; i++) {
+        while ((ret = avcodec_send_packet(ctx, &pkts[i])) == AVERROR(EAGAIN)) {
+            ret = receive_frames(ctx, frame, crcs, nb_frames);
+            if (ret < 0)
+                goto end;
+        }
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Error sending a packet to the decoder\n");
+            goto end;
+        }
+    }
+
+    ret = avcodec_send_packet(ctx, NULL);
+    if (ret < 0) {
+        av_log(ctx, AV_LOG_ERROR, "Error flushing the decoder\n");
+        goto end;
+    }
+    ret = receive_frames(ctx, frame, crcs, nb_frames);
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+int main(void)
+{
+    AVPacket pkts[NUMBER_OF_FRAMES];
+    uint32_t ref_crcs[NUMBER_OF_FRAMES], crcs[NUMBER_OF_FRAMES];
+    int nb_pkts, nb_ref_frames, nb_frames;
+    int i, n, threads, ret;
+
+    memset(pkts, 0, sizeof(pkts));
+
+    avcodec_register_all();
+
+    ret = encode_stream(pkts, &nb_pkts);
+    if (ret < 0)
+        goto end;
+    if (nb_pkts != NUMBER_OF_FRAMES) {
+        av_log(NULL, AV_LOG_ERROR, "Encoded %d packets instead of %d\n",
+               nb_pkts, NUMBER_OF_FRAMES);
+        ret = 1;
+        goto end;
+    }
+
+    for (n = 1; n <= nb_pkts; n++) {
+        ret = decode_packets(pkts, n, 1, ref_crcs, &nb_ref_frames);
+        if (ret < 0)
+            goto end;
+        if (nb_ref_frames != n) {
+            av_log(NULL, AV_LOG_ERROR, "sent=%d got=%d with 1 thread\n",
+                   n, nb_ref_frames);
+            ret = 1;
+            goto end;
+        }
+
+        for (threads = 2; threads <= MAX_THREADS; threads++) {
+            ret = decode_packets(pkts, n, threads, crcs, &nb_frames);
+            if (ret < 0)
+                goto end;
+            if (nb_frames != n) {
+                av_log(NULL, AV_LOG_ERROR, "sent=%d got=%d with %d threads\n",
+                       n, nb_frames, threads);
+                ret = 1;
+                goto end;
+            }
+            for (i = 0; i < n; i++) {
+                if (crcs[i] != ref_crcs[i]) {
+                    av_log(NULL, AV_LOG_ERROR, "Frame %d of %d differs with %d threads\n",
+                           i, n, threads);
+                    ret = 1;
+                    goto end;
+                }
+            }
+        }
+    }
+
+end:
+    for (i = 0; i < nb_pkts; i++)
+        av_packet_unref(&pkts[i]);
+    return ret < 0 ? 1 : ret;
+}
@@ -139,6 +139,9 @@ static const struct {
 #if CONFIG_AVUTIL
         { "fixed_dsp", checkasm_check_fixed_dsp },
         { "float_dsp", checkasm_check_float_dsp },
+#endif
+#if CONFIG_SWSCALE
+        { "sw_scale", checkasm_check_sw_scale },
 #endif
     { NULL }
 };
@@ -0,0 +1,112 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#define MAX_WIDTH 512
+/* the SIMD versions process up to 16 pixels per iteration */
+#define PADDING   16
+
+static const enum AVPixelFormat formats[] = {
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_YUV420P9LE,
+    AV_PIX_FMT_YUV420P10LE,
+    AV_PIX_FMT_YUV420P16LE,
+};
+
+static const int widths[] = { 8, 24, 33, 128, 144, 511 };
+
+static void randomize_src(int32_t *src, int bits)
+{
+    int i;
+
+    for (i = 0; i < MAX_WIDTH + PADDING; i++) {
+        if (bits == 16)
+            src[i] = (int32_t)rnd() >> 9;
+        else
+            ((int16_t *)src)[i] = rnd();
+    }
+}
+
+static void check_yuv2plane1(void)
+{
+    LOCAL_ALIGNED_32(int32_t, src, [MAX_WIDTH + PADDING]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [MAX_WIDTH + PADDING]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [MAX_WIDTH + PADDING]);
+    uint8_t dither[8];
+    int fmt, i, w, offset;
+
+    declare_func(void, const int16_t *src, uint8_t *dst, int dstW,
+                 const uint8_t *dither, int offset);
+
+    for (fmt = 0; fmt < FF_ARRAY_ELEMS(formats); fmt++) {
+        SwsContext *c = sws_alloc_context();
+        int bits;
+
+        if (!c)
+            fail();
+        av_opt_set_int(c, "srcw", MAX_WIDTH / 2, 0);
+        av_opt_set_int(c, "srch", 16, 0);
+        av_opt_set_int(c, "src_format", formats[fmt], 0);
+        av_opt_set_int(c, "dstw", MAX_WIDTH, 0);
+        av_opt_set_int(c, "dsth", 16, 0);
+        av_opt_set_int(c, "dst_format", formats[fmt], 0);
+        av_opt_set_int(c, "sws_flags", SWS_BILINEAR, 0);
+        if (sws_init_context(c, NULL, NULL) < 0) {
+            sws_freeContext(c);
+            fail();
+            continue;
+        }
+        bits = c->dstBpc;
+
+        for (i = 0; i < FF_ARRAY_ELEMS(dither); i++)
+            dither[i] = rnd() & 0x7f;
+
+        for (w = 0; w < FF_ARRAY_ELEMS(widths); w++) {
+            int width = widths[w];
+
+            if (check_func(c->yuv2plane1, "yuv2plane1_%d_%d", bits, width)) {
+                for (offset = 0; offset <= 3; offset += 3) {
+                    randomize_src(src, bits);
+                    memset(dst0, 0, sizeof(*dst0) * (MAX_WIDTH + PADDING));
+                    memset(dst1, 0, sizeof(*dst1) * (MAX_WIDTH + PADDING));
+
+                    call_ref((const int16_t *)src, (uint8_t *)dst0, width, dither, offset);
+                    call_new((const int16_t *)src, (uint8_t *)dst1, width, dither, offset);
+                    if (memcmp(dst0, dst1, width * (bits > 8 ? 2 : 1)))
+                        fail();
+                }
+                bench_new((const int16_t *)src, (uint8_t *)dst1, width, dither, 0);
+            }
+        }
+        sws_freeContext(c);
+    }
+    report("yuv2plane1");
+}
+
+void checkasm_check_sw_scale(void)
+{
+    check_yuv2plane1();
+}
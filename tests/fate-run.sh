@@ -101,6 +101,22 @@ probechapters(){
     run ffprobe${PROGSUF} -show_chapters -v 0 "$@"
 }
 
+probecache(){
+    cachedir="${outdir}/${test}.cache"
+    coldfile="${outdir}/${test}.cold"
+    warmfile="${outdir}/${test}.warm"
+    logfile="${outdir}/${test}.log"
+    cleanfiles="$cleanfiles $coldfile $warmfile $logfile"
+    rm -rf "$cachedir"
+    mkdir -p "$cachedir" || return
+    for pass in cold warm; do
+        run ffprobe${PROGSUF} -bitexact -show_format -show_streams -of compact -v verbose -probe_cache "$cachedir" "$@" > "${outdir}/${test}.${pass}" 2> "$logfile" || return
+        echo "${pass}: loaded $(grep -c 'loaded from the probe cache' "$logfile"), entries $(ls "$cachedir" | grep -c 'ffpc$')"
+    done
+    rm -rf "$cachedir"
+    diff -u "$coldfile" "$warmfile"
+}
+
 probegaplessinfo(){
     filename="$1"
     shift
@@ -204,6 +220,24 @@ enc_dec(){
     tests/tiny_psnr $srcfile $decfile $cmp_unit $cmp_shift
 }
 
+# encode with a single thread and with the threading options in $4, the
+# packets and their timestamps must be identical
+enc_threads_cmp(){
+    src_fmt=$1
+    srcfile=$2
+    enc_opt=$3
+    thread_opt=$4
+    reffile="${outdir}/${test}.ref.framecrc"
+    encfile="${outdir}/${test}.framecrc"
+    cleanfiles="$cleanfiles $reffile $encfile"
+    tsrcfile=$(target_path $srcfile)
+    ffmpeg -f $src_fmt $DEC_OPTS -i $tsrcfile $ENC_OPTS $enc_opt $FLAGS \
+        -threads 1 -f framecrc -y $(target_path $reffile) || return
+    ffmpeg -f $src_fmt $DEC_OPTS -i $tsrcfile $ENC_OPTS $enc_opt $FLAGS \
+        $thread_opt -f framecrc -y $(target_path $encfile) || return
+    diff -u $reffile $encfile
+}
+
 transcode(){
     src_fmt=$1
     srcfile=$2
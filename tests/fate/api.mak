@@ -4,6 +4,12 @@ fate-api-flac: CMD = run $(APITESTSDIR)/api-flac-test
 fate-api-flac: CMP = null
 fate-api-flac: REF = /dev/null
 
+FATE_API_LIBAVCODEC-$(call ALLYES, MPEG4_ENCODER MPEG4_DECODER) += fate-api-frame-thread
+fate-api-frame-thread: $(APITESTSDIR)/api-frame-thread-test$(EXESUF)
+fate-api-frame-thread: CMD = run $(APITESTSDIR)/api-frame-thread-test
+fate-api-frame-thread: CMP = null
+fate-api-frame-thread: REF = /dev/null
+
 FATE_API_SAMPLES_LIBAVFORMAT-$(call DEMDEC, FLV, FLV) += fate-api-band
 fate-api-band: $(APITESTSDIR)/api-band-test$(EXESUF)
 fate-api-band: CMD = run $(APITESTSDIR)/api-band-test $(TARGET_SAMPLES)/mpeg4/resize_down-up.h263
@@ -29,6 +29,20 @@ FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_xml
 fate-ffprobe_xml: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xml: CMD = run $(FFPROBE_COMMAND) -of xml
 
+# decoding the streams in parallel while probing must not change anything
+FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_probe_threads
+fate-ffprobe_probe_threads: $(FFPROBE_TEST_FILE)
+fate-ffprobe_probe_threads: CMD = run $(FFPROBE_COMMAND) -of compact -probe_threads 4
+fate-ffprobe_probe_threads: REF = $(SRC_PATH)/tests/ref/fate/ffprobe_compact
+
+# the second run reads the stream parameters from the cache of the first,
+# unless they were incomplete
+FATE_FFPROBE_PROBE_CACHE-$(call ENCDEC2, MPEG2VIDEO, MP2, MPEGTS) += fate-ffprobe_probe_cache fate-ffprobe_probe_cache_incomplete
+fate-ffprobe_probe_cache: CMD = probecache $(TARGET_PATH)/tests/data/lavf/lavf.ts
+fate-ffprobe_probe_cache_incomplete: CMD = probecache $(TARGET_PATH)/tests/data/lavf/lavf.ts -probesize 32 -analyzeduration 0
+$(FATE_FFPROBE_PROBE_CACHE-yes): fate-lavf-ts
+FATE_FFPROBE-$(CONFIG_FILE_PROTOCOL) += $(FATE_FFPROBE_PROBE_CACHE-yes)
+
 FATE_FFPROBE += $(FATE_FFPROBE-yes)
 
 fate-ffprobe: $(FATE_FFPROBE)
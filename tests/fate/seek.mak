@@ -254,12 +254,29 @@ fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_
 
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
+# mov files read with -compact_index 1 must seek like with the full index
+
+FATE_SEEK_MOV_COMPACT-$(call ENCDEC,  ALAC,             MOV) += acodec-alac
+FATE_SEEK_MOV_COMPACT-$(call ENCDEC,  PCM_S16BE,        MOV) += acodec-pcm-s16be
+FATE_SEEK_MOV_COMPACT-$(call ENCDEC2, MPEG4, PCM_ALAW,  MOV) += lavf-mov
+
+fate-seek-acodec-alac-compact_index:      SRC = fate/acodec-alac.mov
+fate-seek-acodec-pcm-s16be-compact_index: SRC = fate/acodec-pcm-s16be.mov
+fate-seek-lavf-mov-compact_index:         SRC = lavf/lavf.mov
+
+FATE_SEEK_MOV_COMPACT = $(FATE_SEEK_MOV_COMPACT-yes:%=fate-seek-%-compact_index)
+
 
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+$(FATE_SEEK_MOV_COMPACT): libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_MOV_COMPACT): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC) -compact_index 1
+$(FATE_SEEK_MOV_COMPACT): fate-seek-%-compact_index: fate-%
+$(FATE_SEEK_MOV_COMPACT): REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%-compact_index=%)
+
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_MOV_COMPACT)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_MOV_COMPACT)
@@ -236,6 +236,7 @@ FATE_MPEG2 = mpeg2                                                      \
              mpeg2-ilace                                                \
              mpeg2-ivlc-qprd                                            \
              mpeg2-thread                                               \
+             mpeg2-thread-gop                                           \
              mpeg2-thread-ivlc
 
 FATE_VCODEC-$(call ENCDEC, MPEG2VIDEO, MPEG2VIDEO MPEGVIDEO) += $(FATE_MPEG2)
@@ -263,6 +264,14 @@ fate-vsynth%-mpeg2-ivlc-qprd:    ENCOPTS = -b:v 500k                    \
                                            -mbd rd
 fate-vsynth%-mpeg2-thread:       ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
                                            -threads 2 -slices 2
+# the GOPs encoded in parallel must give the same output as a single thread
+fate-vsynth%-mpeg2-thread-gop:   ENCOPTS = -qscale 5 -bf 2 -flags +cgop    \
+                                           -sc_threshold 1000000000
+fate-vsynth%-mpeg2-thread-gop:   SIZE = 352x288
+fate-vsynth3-mpeg2-thread-gop:   SIZE = $(FATEW)x$(FATEH)
+fate-vsynth%-mpeg2-thread-gop:   CMD = enc_threads_cmp "rawvideo -s $(SIZE) -pix_fmt yuv420p" $(SRC) "-c $(CODEC) $(ENCOPTS)" "-threads 4 -thread_type frame"
+fate-vsynth%-mpeg2-thread-gop:   CMP = null
+fate-vsynth%-mpeg2-thread-gop:   REF = /dev/null
 fate-vsynth%-mpeg2-thread-ivlc:  ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
                                            -intra_vlc 1 -threads 2 -slices 2
 